@@ -0,0 +1,400 @@
+/*
+  ==============================================================================
+
+    Benchmarks for the aot_juceplot hot paths.
+
+    Usage: JucePlotBenchmarks [--json] [--max-points <n>] [--test]
+
+    --json prints all results as one JSON object instead of a table, to be
+    compared between builds. --max-points limits the largest sample set,
+    100M points by default, which takes about 2 GB. --test runs the module's
+    unit tests instead and returns 1 if any of them fail.
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+namespace plot = aot::plot;
+namespace et = aot::plot::et;
+
+//==============================================================================
+static const std::size_t NUM_SAMPLES = 4096;
+static const int NUM_ITERATIONS = 2000;
+static const int NUM_FRAMES = 240;
+
+/* Every operator new of the process, allocations per frame are told apart by it */
+static std::atomic<std::size_t> numAllocations { 0 };
+
+void* operator new (std::size_t size)
+{
+    ++numAllocations;
+    
+    if (auto memory = std::malloc(size > 0 ? size : 1))
+        return memory;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    return operator new (size);
+}
+
+void operator delete (void* memory) noexcept                { std::free(memory); }
+void operator delete[] (void* memory) noexcept              { std::free(memory); }
+void operator delete (void* memory, std::size_t) noexcept   { std::free(memory); }
+void operator delete[] (void* memory, std::size_t) noexcept { std::free(memory); }
+
+struct Measurement
+{
+    String name;
+    double value;
+    String unit;
+};
+
+static std::vector<Measurement> measurements;
+static bool jsonOutput = false;
+
+/* Runs func repeatedly and returns the time spent per sample in nanoseconds */
+template <typename FuncT>
+static double measure(FuncT func, std::size_t samplesPerCall, int iterations = NUM_ITERATIONS)
+{
+    // warm up caches and lazily selected kernels
+    func();
+
+    auto start = Time::getHighResolutionTicks();
+    for (int i = 0; i < iterations; ++i)
+        func();
+
+    auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    return seconds * 1e9 / (double(iterations) * samplesPerCall);
+}
+
+static void report(const String& name, double value, const String& unit = "ns/sample")
+{
+    measurements.push_back({ name, value, unit });
+    
+    if (! jsonOutput)
+        std::cout << name.paddedRight(' ', 40) << String(value, 3) << " " << unit << std::endl;
+}
+
+/* Runs frame numFrames times, reports frames per second and allocations per frame */
+template <typename FrameT>
+static void measureFrames(const String& name, FrameT frame, int numFrames = NUM_FRAMES)
+{
+    frame(0);
+    
+    auto allocations = numAllocations.load();
+    auto start = Time::getHighResolutionTicks();
+    
+    for (int i = 0; i < numFrames; ++i)
+        frame(i);
+    
+    auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    
+    report(name, numFrames / seconds, "frames/s");
+    report(name + " allocations", double(numAllocations.load() - allocations) / numFrames, "allocations/frame");
+}
+
+static void writeJson()
+{
+    Array<var> results;
+    
+    for (auto& measurement : measurements)
+    {
+        DynamicObject::Ptr result = new DynamicObject();
+        result->setProperty("name", measurement.name);
+        result->setProperty("value", measurement.value);
+        result->setProperty("unit", measurement.unit);
+        results.add(var(result.get()));
+    }
+    
+    DynamicObject::Ptr root = new DynamicObject();
+    root->setProperty("cpus", SystemStats::getNumCpus());
+    root->setProperty("results", results);
+    
+    std::cout << JSON::toString(var(root.get())) << std::endl;
+}
+
+/* Evaluates an erased tree against an alternative representation of the same formula */
+static void compareExpression(const String& name, plot::Expression erased, plot::Expression alternative)
+{
+    std::vector<double> xs(NUM_SAMPLES), ys(NUM_SAMPLES);
+    for (std::size_t i = 0; i < NUM_SAMPLES; ++i)
+        xs[i] = -10 + 20.0 * i / NUM_SAMPLES;
+
+    for (auto precision : { plot::EXACT, plot::FAST })
+    {
+        auto suffix = precision == plot::EXACT ? " exact" : " fast";
+
+        report(name + " erased" + suffix, measure([&] {
+            erased.evaluate(xs.data(), ys.data(), NUM_SAMPLES, precision);
+        }, NUM_SAMPLES));
+
+        report(name + " alternative" + suffix, measure([&] {
+            alternative.evaluate(xs.data(), ys.data(), NUM_SAMPLES, precision);
+        }, NUM_SAMPLES));
+    }
+}
+
+static void benchmarkExpressionTemplates()
+{
+    compareExpression("polynomial",
+        plot::x * plot::x * 0.5 + plot::x * 3 + 1,
+        et::x * et::x * 0.5 + et::x * 3 + 1);
+
+    compareExpression("sin(x*2+1)",
+        plot::sin(plot::x * 2 + 1),
+        et::sin(et::x * 2 + 1));
+
+    compareExpression("composite",
+        plot::sin(plot::x * 2 + 1) * plot::x + plot::exp(plot::cos(plot::x)) * 0.5,
+        et::sin(et::x * 2 + 1) * et::x + et::exp(et::cos(et::x)) * 0.5);
+}
+
+/* A nested formula as an Expression tree and as a parsed Program */
+static void benchmarkProgram(int depth)
+{
+    String text = "x";
+    plot::Expression tree = plot::x;
+
+    for (int i = 0; i < depth; ++i)
+    {
+        text = "sin(" + text + ") * 0.9 + x * 0.1";
+        tree = plot::sin(tree) * 0.9 + plot::x * 0.1;
+    }
+
+    plot::Program program;
+    auto result = plot::Program::parse(text, program);
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return;
+    }
+
+    compareExpression("program depth " + String(depth), tree, program);
+}
+
+/* Cost of rebuilding a parameterised formula, e.g. while a slider is dragged */
+static void benchmarkBuilding(int depth)
+{
+    double gain = 0.9;
+    plot::Expression keep = plot::x;
+
+    report("build tree depth " + String(depth), measure([&] {
+        plot::Expression tree = plot::x;
+        for (int i = 0; i < depth; ++i)
+            tree = plot::sin(tree) * gain + plot::x * 0.1;
+
+        keep = tree;
+        gain += 1e-9;
+    }, 1, NUM_ITERATIONS * 10), "ns/build");
+
+    plot::Program program;
+
+    report("build program depth " + String(depth), measure([&] {
+        plot::Program::TreeBuilder tree(program);
+
+        auto value = tree.x();
+        for (int i = 0; i < depth; ++i)
+            value = tree.add(tree.multiply(tree.sin(value), tree.constant(gain)),
+                             tree.multiply(tree.x(), tree.constant(0.1)));
+
+        tree.finish(value);
+        gain += 1e-9;
+    }, 1, NUM_ITERATIONS * 10), "ns/build");
+}
+
+/* A sum of width independent terms, as an Expression tree and as a parsed Program */
+static void benchmarkWidth(int width)
+{
+    String text = "0";
+    plot::Expression tree = 0.0;
+
+    for (int i = 1; i <= width; ++i)
+    {
+        text += " + sin(x * " + String(i) + ")";
+        tree = tree + plot::sin(plot::x * double(i));
+    }
+
+    plot::Program program;
+    auto result = plot::Program::parse(text, program);
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return;
+    }
+
+    compareExpression("program width " + String(width), tree, program);
+}
+
+/* Lookups at random positions and evaluation along increasing ones */
+static void benchmarkSamples(std::size_t maxPoints)
+{
+    for (std::size_t size = 1000; size <= maxPoints; size *= 10)
+    {
+        plot::PlotSamples samples;
+        for (std::size_t i = 0; i < size; ++i)
+            samples.pushBack(double(i), std::sin(i * 0.001));
+
+        Random random(42);
+        std::vector<double> xs(NUM_SAMPLES), ys(NUM_SAMPLES);
+        for (auto& x : xs)
+            x = random.nextDouble() * (size - 1);
+
+        auto name = "samples " + String((int64) size);
+
+        report(name + " operator[]", measure([&] {
+            for (std::size_t i = 0; i < NUM_SAMPLES; ++i)
+                ys[i] = samples[xs[i]];
+        }, NUM_SAMPLES, 200));
+
+        std::sort(xs.begin(), xs.end());
+
+        report(name + " evaluate", measure([&] {
+            samples.evaluate(xs.data(), ys.data(), NUM_SAMPLES, plot::EXACT);
+        }, NUM_SAMPLES, 200));
+    }
+}
+
+static void addCurves(std::function<void(plot::Expression, Colour, String)> add)
+{
+    plot::Program program;
+    auto result = plot::Program::parse("sin(x * 2 + 1) * x + exp(cos(x)) * 0.5", program);
+
+    // Results without the curve would not compare with earlier ones
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        std::exit(1);
+    }
+
+    add(plot::sin(plot::x), Colours::blue, "sin");
+    add(plot::x * plot::x * 0.1 + -1.0, Colours::red, "parabola");
+    add(program, Colours::green, "composite");
+}
+
+/*
+    Paints into an off-screen image: the axes alone, redrawn every frame since
+    the range is set anew, then the curves sampled and stroked every frame over
+    axes drawn once.
+*/
+static void benchmarkPaint(int width, int height)
+{
+    auto size = String(width) + "x" + String(height);
+    plot::PlotRange range(-10, 10, -3, 3);
+    Image image(Image::ARGB, width, height, true, SoftwareImageType());
+
+    plot::PlotStream axes;
+    axes.setWindow(width, height);
+
+    measureFrames("axes " + size, [&](int) {
+        axes.setPlotRange(range);
+        Graphics graphics(image);
+        axes.plot(graphics);
+    });
+
+    plot::PlotStream curves;
+    curves.setWindow(width, height);
+    curves.setPlotRange(range);
+    addCurves([&](plot::Expression expr, Colour colour, String name) {
+        curves.addPlotData(expr, colour, name);
+    });
+
+    measureFrames("curves " + size, [&](int) {
+        Graphics graphics(image);
+        curves.plot(graphics);
+    });
+}
+
+/* Zooming in and out, then panning back and forth, a complete paint per step */
+static void benchmarkInteraction(int width, int height)
+{
+    auto size = String(width) + "x" + String(height);
+    Image image(Image::ARGB, width, height, true, SoftwareImageType());
+
+    plot::PlotComponent component;
+    component.setSize(width, height);
+    component.setPlotRange(-10, 10, -3, 3);
+    addCurves([&](plot::Expression expr, Colour colour, String name) {
+        component.addPlotData(expr, colour, name);
+    });
+
+    auto paint = [&] {
+        Graphics graphics(image);
+        component.paintEntireComponent(graphics, false);
+    };
+
+    measureFrames("zoom " + size, [&](int frame) {
+        auto factor = frame % 120 < 60 ? 0.97f : 1.0f / 0.97f;
+        component.zoom(0.5f, 0.5f, factor, factor);
+        paint();
+    });
+
+    measureFrames("pan " + size, [&](int frame) {
+        component.move(frame % 120 < 60 ? 0.05f : -0.05f, 0.0f);
+        paint();
+    });
+}
+
+//==============================================================================
+static int runUnitTests()
+{
+    Array<UnitTest*> tests;
+
+    for (auto* test : UnitTest::getAllTests())
+        if (test->getName().startsWith("aot_juceplot"))
+            tests.add(test);
+
+    UnitTestRunner runner;
+    runner.runTests(tests);
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        if (runner.getResult(i)->failures > 0)
+            return 1;
+
+    return 0;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    std::size_t maxPoints = 100000000;
+    bool runTests = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (String(argv[i]) == "--json")
+            jsonOutput = true;
+        else if (String(argv[i]) == "--max-points" && i + 1 < argc)
+            maxPoints = (std::size_t) String(argv[++i]).getLargeIntValue();
+        else if (String(argv[i]) == "--test")
+            runTests = true;
+    }
+
+    // Components need a message manager
+    ScopedJuceInitialiser_GUI initialiser;
+
+    if (runTests)
+        return runUnitTests();
+
+    benchmarkExpressionTemplates();
+    benchmarkProgram(4);
+    benchmarkProgram(20);
+    benchmarkWidth(4);
+    benchmarkWidth(32);
+    benchmarkBuilding(20);
+    benchmarkSamples(maxPoints);
+
+    for (auto size : { Point<int>(320, 240), Point<int>(1280, 720), Point<int>(2560, 1440) })
+    {
+        benchmarkPaint(size.x, size.y);
+        benchmarkInteraction(size.x, size.y);
+    }
+
+    if (jsonOutput)
+        writeJson();
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+  ==============================================================================
+
+    Renders plots to PNG files without a display, for batch generated reports.
+
+    Usage: JucePlotRender <jobs file> [<output directory>]
+
+    Every line of the jobs file is one plot, fields separated by spaces:
+
+        <file.png> <width> <height> <loX> <hiX> <loY> <hiY> <formula> [| <formula> ...]
+
+    Empty lines and lines starting with '#' are skipped. Files are written to
+    the output directory, the jobs file's one by default.
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+namespace plot = aot::plot;
+
+//==============================================================================
+struct Job
+{
+    String file;
+    int width = 0;
+    int height = 0;
+    plot::PlotRange range;
+    StringArray formulas;
+};
+
+static const Colour PALETTE[] =
+{
+    Colours::blue, Colours::red, Colours::green, Colours::orange, Colours::purple, Colours::brown
+};
+
+static Result parseJob(const String& line, Job& job)
+{
+    StringArray fields;
+    auto rest = line.trim();
+    
+    for (int i = 0; i < 7 && rest.isNotEmpty(); ++i)
+    {
+        fields.add(rest.upToFirstOccurrenceOf(" ", false, false));
+        rest = rest.fromFirstOccurrenceOf(" ", false, false).trim();
+    }
+    
+    if (fields.size() < 7 || rest.isEmpty())
+        return Result::fail("expected <file.png> <width> <height> <loX> <hiX> <loY> <hiY> <formula>");
+    
+    job.file = fields[0];
+    job.width = fields[1].getIntValue();
+    job.height = fields[2].getIntValue();
+    job.range = plot::PlotRange(fields[3].getDoubleValue(), fields[4].getDoubleValue(),
+                                fields[5].getDoubleValue(), fields[6].getDoubleValue());
+    
+    if (job.width <= 0 || job.height <= 0)
+        return Result::fail("size must be positive");
+    
+    job.formulas = StringArray::fromTokens(rest, "|", "");
+    job.formulas.trim();
+    job.formulas.removeEmptyStrings();
+    
+    return Result::ok();
+}
+
+static Result render(const Job& job, const File& outputDirectory)
+{
+    std::vector<plot::PlotData> curves;
+    
+    for (int i = 0; i < job.formulas.size(); ++i)
+    {
+        plot::Program program;
+        auto result = plot::Program::parse(job.formulas[i], program);
+        
+        if (result.failed())
+            return Result::fail(job.formulas[i] + ": " + result.getErrorMessage());
+        
+        curves.emplace_back(program, job.formulas[i], PALETTE[i % numElementsInArray(PALETTE)]);
+    }
+    
+    auto file = outputDirectory.getChildFile(job.file);
+    file.deleteFile();
+    
+    FileOutputStream stream(file);
+    if (stream.failedToOpen())
+        return Result::fail("could not write " + file.getFullPathName());
+    
+    if (! plot::renderPlotAsPng(stream, curves, job.range, job.width, job.height))
+        return Result::fail("could not encode " + file.getFullPathName());
+    
+    return Result::ok();
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    // Images and fonts need the message manager and the platform's font backend
+    ScopedJuceInitialiser_GUI initialiser;
+    
+    if (argc < 2)
+    {
+        std::cout << "Usage: JucePlotRender <jobs file> [<output directory>]" << std::endl;
+        return 1;
+    }
+    
+    auto jobsFile = File::getCurrentWorkingDirectory().getChildFile(argv[1]);
+    auto outputDirectory = argc > 2 ? File::getCurrentWorkingDirectory().getChildFile(argv[2])
+                                    : jobsFile.getParentDirectory();
+    
+    if (! jobsFile.existsAsFile())
+    {
+        std::cout << "Cannot read " << jobsFile.getFullPathName() << std::endl;
+        return 1;
+    }
+    
+    auto created = outputDirectory.createDirectory();
+    if (created.failed())
+    {
+        std::cout << created.getErrorMessage() << std::endl;
+        return 1;
+    }
+    
+    StringArray lines;
+    jobsFile.readLines(lines);
+    
+    std::vector<Job> jobs;
+    auto numFailed = 0;
+    
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        auto line = lines[i].trim();
+        if (line.isEmpty() || line.startsWithChar('#'))
+            continue;
+        
+        Job job;
+        auto result = parseJob(line, job);
+        
+        if (result.failed())
+        {
+            std::cout << jobsFile.getFileName() << ":" << (i + 1) << ": " << result.getErrorMessage() << std::endl;
+            ++numFailed;
+            continue;
+        }
+        
+        jobs.push_back(job);
+    }
+    
+    // One plot per job, all jobs spread over the threads the plots share
+    std::vector<String> errors(jobs.size());
+    auto start = Time::getHighResolutionTicks();
+    
+    plot::parallel::forEach(jobs.size(), [&](std::size_t i)
+    {
+        auto result = render(jobs[i], outputDirectory);
+        if (result.failed())
+            errors[i] = jobs[i].file + ": " + result.getErrorMessage();
+    });
+    
+    auto seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+    
+    for (auto& error : errors)
+    {
+        if (error.isNotEmpty())
+        {
+            std::cout << error << std::endl;
+            ++numFailed;
+        }
+    }
+    
+    std::cout << jobs.size() << " plots in " << String(seconds, 3) << " s, "
+              << String(jobs.size() / jmax(seconds, 1e-9), 1) << " plots/s" << std::endl;
+    
+    return numFailed > 0 ? 1 : 0;
+}
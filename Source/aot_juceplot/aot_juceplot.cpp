@@ -4,11 +4,25 @@
 #include <string>
 #include <sstream>
 #include <cfloat>
+#include <cstring>
+#include <clocale>
+#include <cstdio>
+#include <cctype>
+#include <map>
+#include <tuple>
+#include <atomic>
 
 #include "aot_juceplot.h"
 
 namespace aot { namespace plot {
 
+#include "core/PlotParallel.cpp"
+#include "core/PlotProgram.cpp"
+#include "core/PlotSeries.cpp"
+#include "core/PlotLoader.cpp"
+#include "core/PlotSampler.cpp"
+#include "core/PlotRaster.cpp"
 #include "core/PlotStream.cpp"
+#include "core/PlotRender.cpp"
 
 }}
@@ -28,13 +28,25 @@
 /* -------------------------------------------------------- */
 
 #include <sstream>
+#include <cstdint>
+#include <atomic>
 
 namespace aot { namespace plot {
 
+    #include "core/PlotSimd.h"
+    #include "core/PlotParallel.h"
     #include "core/PlotExpression.h"
+    #include "core/PlotExpressionTemplates.h"
+    #include "core/PlotSeries.h"
+    #include "core/PlotLoader.h"
     #include "core/PlotData.h"
+    #include "core/PlotProgram.h"
+    #include "core/PlotSampler.h"
     #include "core/PlotRange.h"
+    #include "core/PlotRaster.h"
+    #include "core/PlotInstrumentation.h"
     #include "core/PlotStream.h"
+    #include "core/PlotRender.h"
     #include "gui/PlotComponent.h"
 
 } }
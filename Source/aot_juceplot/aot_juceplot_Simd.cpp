@@ -0,0 +1,26 @@
+/*
+    The block kernels are a translation unit of their own. The AVX2 helpers pass
+    vectors by value, they are only ever inlined into AVX2 entry points, but GCC
+    warns about the ABI when it analyses them at the end of the unit: the
+    warning can only be turned off for a whole unit, and this one holds nothing else.
+*/
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "aot_juceplot.h"
+
+#if JUCE_GCC
+ #pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace aot { namespace plot {
+
+#include "core/PlotSimd.cpp"
+
+}}
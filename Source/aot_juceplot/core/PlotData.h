@@ -25,19 +25,16 @@ enum Grain
 	GROSS = 101
 };
 
-struct PlotSampler
-{
-    
-};
-
 struct PlotData
 {
-    PlotData(Expression expr, juce::String name, juce::Colour colour) : expr(expr), name(name), colour(colour)
+    PlotData(Expression expr, juce::String name, juce::Colour colour, Precision precision = EXACT)
+    : expr(expr), name(name), colour(colour), precision(precision)
     {}
     
     Expression expr;
     juce::String name;
     juce::Colour colour;
+    Precision precision;
     
 };
 
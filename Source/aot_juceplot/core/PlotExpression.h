@@ -1,9 +1,54 @@
 #pragma once
 
+/** Number of samples a node evaluates per pass over its children */
+static const std::size_t BLOCK_SIZE = 128;
+
+struct ConstExpression;
+struct Expression;
+
+/*
+    Receives an expression tree node by node when it is compiled into a Program.
+    Every call returns the id of the value it defines, which can be used as
+    operand of later calls.
+*/
+struct ExpressionCompiler
+{
+    enum OpCode
+    {
+        LOAD_X,
+        LOAD_CONST,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        NEG,
+        POW,
+        CALL,
+        EVAL    // an expression that cannot be compiled, evaluated as a whole
+    };
+
+    virtual ~ExpressionCompiler() = default;
+
+    virtual int loadX() = 0;
+    virtual int constant(double value) = 0;
+    virtual int binary(OpCode op, int lhs, int rhs) = 0;
+    virtual int unary(OpCode op, int operand) = 0;
+    virtual int call(double (*func)(double), simd::UnaryKernel fastFunc, int operand) = 0;
+    virtual int expression(const Expression& expr) = 0;
+};
+
+/* Summary of the samples falling into one pixel column, all NaN if there are none */
+struct ColumnEnvelope
+{
+    double first;
+    double last;
+    double min;
+    double max;
+};
+
 struct Expression
 {
-    struct ConstExpression;
-    
+
     template <typename ConstT>
     Expression(ConstT value, typename std::enable_if<std::is_arithmetic<ConstT>::value>::type* = 0)
     : _data(std::make_shared<Model<ConstExpression>>(value))
@@ -21,12 +66,42 @@ struct Expression
         return (*_data)[i];
     }
     
+    /* Evaluate the expression at n positions xs into ys. xs and ys must not overlap */
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision = EXACT) const
+    {
+        _data->evaluate(xs, ys, n, precision);
+    }
+    
+    /*
+        Summarises the expression per column, column i covering edges[i] <= x < edges[i + 1].
+        Returns false if the expression has nothing better to offer than evaluating it.
+    */
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        return _data->envelope(edges, numColumns, columns);
+    }
+    
+    /* Hands the tree to compiler, nodes it does not know are passed as a whole */
+    int compile(ExpressionCompiler& compiler) const
+    {
+        return _data->compile(compiler, *this);
+    }
+    
+    /* Copies of an Expression share their node, which makes them the same value */
+    bool isSameNode(const Expression& other) const
+    {
+        return _data == other._data;
+    }
+    
 private:
     
     struct Contract
     {
         virtual ~Contract() = default;
         virtual double operator[](double i) const = 0;
+        virtual void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const = 0;
+        virtual int compile(ExpressionCompiler& compiler, const Expression& self) const = 0;
+        virtual bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const = 0;
     };
     
     template <typename ExprT>
@@ -39,7 +114,67 @@ private:
             return _data[i];
         }
         
+        void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const override
+        {
+            evaluate(_data, xs, ys, n, precision, 0);
+        }
+        
+        int compile(ExpressionCompiler& compiler, const Expression& self) const override
+        {
+            auto value = compile(_data, compiler, 0);
+            return value >= 0 ? value : compiler.expression(self);
+        }
+        
+        bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const override
+        {
+            return envelope(_data, edges, numColumns, columns, 0);
+        }
+        
     private:
+        // Expressions providing their own block evaluation
+        template <typename T>
+        static auto evaluate(const T& expr, const double* xs, double* ys, std::size_t n, Precision precision, int)
+            -> decltype(expr.evaluate(xs, ys, n, precision), void())
+        {
+            expr.evaluate(xs, ys, n, precision);
+        }
+        
+        // Fallback for expressions that can only be evaluated point by point
+        template <typename T>
+        static void evaluate(const T& expr, const double* xs, double* ys, std::size_t n, Precision, long)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                ys[i] = expr[xs[i]];
+        }
+        
+        // Expressions that can lower themselves, a negative result means they could not
+        template <typename T>
+        static auto compile(const T& expr, ExpressionCompiler& compiler, int)
+            -> decltype(expr.compile(compiler))
+        {
+            return expr.compile(compiler);
+        }
+        
+        template <typename T>
+        static int compile(const T&, ExpressionCompiler&, long)
+        {
+            return -1;
+        }
+        
+        // Expressions holding samples that a few evaluations would not do justice to
+        template <typename T>
+        static auto envelope(const T& expr, const double* edges, std::size_t numColumns, ColumnEnvelope* columns, int)
+            -> decltype(expr.envelope(edges, numColumns, columns))
+        {
+            return expr.envelope(edges, numColumns, columns);
+        }
+        
+        template <typename T>
+        static bool envelope(const T&, const double*, std::size_t, ColumnEnvelope*, long)
+        {
+            return false;
+        }
+        
         ExprT _data;
     };
     
@@ -52,6 +187,16 @@ struct XExpression
     {
         return i;
     }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        std::copy(xs, xs + n, ys);
+    }
+    
+    int compile(ExpressionCompiler& compiler) const
+    {
+        return compiler.loadX();
+    }
 };
 
 struct ConstExpression
@@ -63,24 +208,86 @@ struct ConstExpression
         return _val;
     }
     
+    void evaluate(const double*, double* ys, std::size_t n, Precision) const
+    {
+        std::fill(ys, ys + n, _val);
+    }
+    
+    int compile(ExpressionCompiler& compiler) const
+    {
+        return compiler.constant(_val);
+    }
+    
 private:
     double _val;
 };
 
 struct Function
 {
-    Function(double (*func)(double), Expression expr) : _func(func), _expr(expr) { }
+    Function(double (*func)(double), Expression expr, simd::UnaryKernel fastFunc = nullptr)
+    : _func(func), _fastFunc(fastFunc), _expr(expr) { }
     
     double operator[](double i) const
     {
         return _func(_expr[i]);
     }
     
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+    {
+        _expr.evaluate(xs, ys, n, precision);
+        
+        if (precision == FAST && _fastFunc)
+        {
+            _fastFunc(ys, ys, n);
+            return;
+        }
+        
+        for (std::size_t i = 0; i < n; ++i)
+            ys[i] = _func(ys[i]);
+    }
+    
+    int compile(ExpressionCompiler& compiler) const
+    {
+        return compiler.call(_func, _fastFunc, _expr.compile(compiler));
+    }
+    
 private:
-    std::function<double(double)> _func;
+    double (*_func)(double);
+    simd::UnaryKernel _fastFunc;
     Expression _expr;
 };
 
+/* Vectorised block kernel for an operation, if there is one */
+template <typename OperationT>
+struct OperationKernel
+{
+    static simd::BinaryKernel get() { return nullptr; }
+};
+
+template <>
+struct OperationKernel<std::plus<double>>
+{
+    static simd::BinaryKernel get() { return simd::getKernels().add; }
+};
+
+template <>
+struct OperationKernel<std::multiplies<double>>
+{
+    static simd::BinaryKernel get() { return simd::getKernels().multiply; }
+};
+
+/* Instruction an operation compiles to, operations without one stay opaque */
+template <typename OperationT>
+struct OperationCode
+{
+    static const int value = -1;
+};
+
+template <> struct OperationCode<std::plus<double>>       { static const int value = ExpressionCompiler::ADD; };
+template <> struct OperationCode<std::minus<double>>      { static const int value = ExpressionCompiler::SUB; };
+template <> struct OperationCode<std::multiplies<double>> { static const int value = ExpressionCompiler::MUL; };
+template <> struct OperationCode<std::divides<double>>    { static const int value = ExpressionCompiler::DIV; };
+
 template <typename OperationT>
 struct Operation
 {
@@ -94,11 +301,219 @@ struct Operation
         return operation(_lhs[i], _rhs[i]);
     }
     
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+    {
+        OperationT operation;
+        auto kernel = OperationKernel<OperationT>::get();
+        double rhs[BLOCK_SIZE];
+        
+        for (std::size_t offset = 0; offset < n; offset += BLOCK_SIZE)
+        {
+            auto count = std::min(BLOCK_SIZE, n - offset);
+            auto out = ys + offset;
+            
+            _lhs.evaluate(xs + offset, out, count, precision);
+            _rhs.evaluate(xs + offset, rhs, count, precision);
+            
+            if (kernel)
+            {
+                kernel(out, rhs, out, count);
+                continue;
+            }
+            
+            for (std::size_t i = 0; i < count; ++i)
+                out[i] = operation(out[i], rhs[i]);
+        }
+    }
+    
+    int compile(ExpressionCompiler& compiler) const
+    {
+        auto op = OperationCode<OperationT>::value;
+        if (op < 0)
+            return -1;
+        
+        auto lhs = _lhs.compile(compiler);
+        auto rhs = _rhs.compile(compiler);
+        return compiler.binary(static_cast<ExpressionCompiler::OpCode>(op), lhs, rhs);
+    }
+    
 private:
     Expression _lhs;
     Expression _rhs;
 };
 
+/*
+    Lookup, interpolation and per column summaries of samples with increasing x,
+    the same for every series whatever holds its samples. SourceT provides
+
+        std::size_t size() const
+        double getX(std::size_t index) const
+        double getY(std::size_t index) const
+
+    and optionally the y range of the samples [begin, end), e.g. from a pyramid,
+    which is found by reading them all otherwise:
+
+        void findRange(std::size_t begin, std::size_t end, double& min, double& max) const
+
+    The size is read once, a series that grows meanwhile is used as it was.
+*/
+template <typename SourceT>
+class SampleSeries
+{
+public:
+    explicit SampleSeries(const SourceT& source) : _source(source), _size(source.size())
+    {
+    }
+    
+    double operator[](double x) const
+    {
+        if (_size == 0 || x < _source.getX(0) || x > _source.getX(_size - 1))
+            return std::numeric_limits<double>::quiet_NaN();
+        
+        return interpolate(seek(0, x), x);
+    }
+    
+    /*
+        Positions are usually increasing, so a cursor moves along the samples
+        instead of searching for every position: a frame costs O(n + m) rather
+        than O(m log n), and skipping far ahead gallops in O(log distance).
+    */
+    void evaluate(const double* xs, double* ys, std::size_t n) const
+    {
+        std::size_t cursor = 0;
+        
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto x = xs[i];
+            
+            if (_size == 0 || x < _source.getX(0) || x > _source.getX(_size - 1))
+            {
+                ys[i] = std::numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+            
+            // Going backwards starts over
+            if (cursor > 0 && _source.getX(cursor - 1) >= x)
+                cursor = 0;
+            
+            cursor = seek(cursor, x);
+            ys[i] = interpolate(cursor, x);
+        }
+    }
+    
+    /* Summarises the samples per column, as long as there are more than a few per column */
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        if (_size == 0 || numColumns == 0)
+            return false;
+        
+        auto cursor = seek(0, edges[0]);
+        auto end = seek(cursor, edges[numColumns]);
+        
+        // Sparse data is drawn exactly by interpolating it
+        if (end - cursor < 2 * numColumns)
+            return false;
+        
+        auto nan = std::numeric_limits<double>::quiet_NaN();
+        
+        for (std::size_t i = 0; i < numColumns; ++i)
+        {
+            auto next = seek(cursor, edges[i + 1]);
+            
+            if (next == cursor)
+            {
+                columns[i] = { nan, nan, nan, nan };
+                continue;
+            }
+            
+            double min, max;
+            findRange(_source, cursor, next, min, max, 0);
+            
+            if (min > max)
+                min = max = nan;
+            
+            columns[i] = { _source.getY(cursor), _source.getY(next - 1), min, max };
+            cursor = next;
+        }
+        
+        return true;
+    }
+    
+private:
+    /* Index of the first sample at or after `from` with getX() >= x, or size() */
+    std::size_t seek(std::size_t from, double x) const
+    {
+        // Gallop to bracket x, then search inside the bracket: samples in between stay untouched
+        std::size_t step = 1;
+        auto lo = from;
+        auto hi = from;
+        
+        while (hi < _size && _source.getX(hi) < x)
+        {
+            lo = hi + 1;
+            hi = std::min(_size, hi + step);
+            step *= 2;
+        }
+        
+        while (lo < hi)
+        {
+            auto mid = lo + (hi - lo) / 2;
+            
+            if (_source.getX(mid) < x)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        
+        return lo;
+    }
+    
+    double interpolate(std::size_t index, double x) const
+    {
+        if (index == 0) return _source.getY(0);
+        
+        auto x0 = _source.getX(index - 1);
+        auto x1 = _source.getX(index);
+        
+        return (_source.getY(index - 1) * (x1 - x) + _source.getY(index) * (x - x0)) / (x1 - x0);
+    }
+    
+    // Sources with a range query of their own
+    template <typename T>
+    static auto findRange(const T& source, std::size_t begin, std::size_t end, double& min, double& max, int)
+        -> decltype(source.findRange(begin, end, min, max), void())
+    {
+        source.findRange(begin, end, min, max);
+    }
+    
+    // Reads every sample, NaN never changes the range
+    template <typename T>
+    static void findRange(const T& source, std::size_t begin, std::size_t end, double& min, double& max, long)
+    {
+        min = std::numeric_limits<double>::infinity();
+        max = -min;
+        
+        for (auto i = begin; i < end; ++i)
+        {
+            auto y = source.getY(i);
+            min = y < min ? y : min;
+            max = y > max ? y : max;
+        }
+    }
+    
+    const SourceT& _source;
+    std::size_t _size;
+};
+
+/*
+    Samples with increasing x, interpolated linearly in between.
+
+    Next to the samples a min/max pyramid is kept up to date: level 0 holds the
+    y range of every LEAF_SIZE samples, every level above merges pairs of the
+    level below. The y range of any index range is then found in O(log n), which
+    lets envelope() summarise hundreds of millions of samples per pixel column
+    without missing a peak. The pyramid adds about one eighth to the memory used.
+*/
 struct PlotSamples
 {
     void pushBack(double x, double y)
@@ -109,30 +524,154 @@ struct PlotSamples
     void pushBack(juce::Point<double> sample)
     {
         _samples.push_back(std::move(sample));
+        updatePyramid(_samples.size() - 1, _samples.back().getY());
+    }
+    
+    std::size_t size() const
+    {
+        return _samples.size();
+    }
+    
+    /* x of the newest sample, -infinity while there is none */
+    double getLastX() const
+    {
+        return _samples.empty() ? -std::numeric_limits<double>::infinity() : _samples.back().getX();
     }
     
     double operator[](double i) const
     {
-        if (i < _samples[0].getX() || i > _samples.back().getX())
-            return std::numeric_limits<double>::quiet_NaN();
+        return SampleSeries<PlotSamples>(*this)[i];
+    }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        SampleSeries<PlotSamples>(*this).evaluate(xs, ys, n);
+    }
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        return SampleSeries<PlotSamples>(*this).envelope(edges, numColumns, columns);
+    }
+    
+private:
+    friend class SampleSeries<PlotSamples>;
+    
+    struct MinMax
+    {
+        double min;
+        double max;
         
-        juce::Point<double> searchValue {i, 0};
-        auto it = std::lower_bound(_samples.begin(), _samples.end(), searchValue,
-            [](auto& element, auto& value) { return element.getX() < value.getX(); });
-
-        if (it == _samples.begin()) return _samples[0].getY();
-
-        auto& p1 = *it;
-        auto& p0 = *(it -1);
+        /* Returns false if y was already inside, NaN never changes the range */
+        bool add(double y)
+        {
+            auto changed = false;
+            if (y < min) { min = y; changed = true; }
+            if (y > max) { max = y; changed = true; }
+            return changed;
+        }
         
-        return (p0.getY() * (p1.getX() - i) + p1.getY() * (i - p0.getX())) / (p1.getX() - p0.getX());
+        void add(const MinMax& other)
+        {
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+        }
+    };
+    
+    static const std::size_t LEAF_SIZE = 16;
+    
+    static MinMax emptyRange()
+    {
+        return { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
     }
     
-private:
-    mutable double lastX_;
-    mutable std::size_t _lastI;
+    double getX(std::size_t index) const
+    {
+        return _samples[index].getX();
+    }
+    
+    double getY(std::size_t index) const
+    {
+        return _samples[index].getY();
+    }
+    
+    void updatePyramid(std::size_t index, double y)
+    {
+        auto blockSize = LEAF_SIZE;
+        
+        for (std::size_t level = 0; ; ++level, blockSize *= 2)
+        {
+            if (level == _levels.size())
+            {
+                // A new top level once the one below has two entries
+                if (level > 0 && _levels[level - 1].size() < 2)
+                    return;
+                
+                _levels.emplace_back();
+                
+                if (level > 0)
+                {
+                    auto& below = _levels[level - 1];
+                    auto top = below[0];
+                    top.add(below[1]);
+                    _levels[level].push_back(top);
+                    continue;
+                }
+            }
+            
+            auto& entries = _levels[level];
+            
+            if (index % blockSize == 0)
+            {
+                entries.push_back(emptyRange());
+                entries.back().add(y);
+            }
+            else if (! entries.back().add(y))
+            {
+                // Levels above contain this block, so they are unchanged as well
+                return;
+            }
+        }
+    }
+    
+    /* Range of y over the samples [begin, end) */
+    void findRange(std::size_t begin, std::size_t end, double& min, double& max) const
+    {
+        auto range = emptyRange();
+        
+        while (begin < end && begin % LEAF_SIZE != 0)
+            range.add(_samples[begin++].getY());
+        
+        std::size_t level = 0;
+        auto blockSize = LEAF_SIZE;
+        
+        while (begin + blockSize <= end)
+        {
+            // Largest aligned block that fits
+            while (level + 1 < _levels.size() && begin % (blockSize * 2) == 0 && begin + blockSize * 2 <= end)
+            {
+                ++level;
+                blockSize *= 2;
+            }
+            
+            range.add(_levels[level][begin / blockSize]);
+            begin += blockSize;
+            
+            while (level > 0 && begin + blockSize > end)
+            {
+                --level;
+                blockSize /= 2;
+            }
+        }
+        
+        while (begin < end)
+            range.add(_samples[begin++].getY());
+        
+        min = range.min;
+        max = range.max;
+    }
     
     std::vector<juce::Point<double>> _samples;
+    std::vector<std::vector<MinMax>> _levels;
 };
 
 
@@ -153,7 +692,25 @@ static Expression operator+(Expression lhs, Expression rhs)
 [[maybe_unused]]
 static Expression sin(Expression expr)
 {
-    return plot::Function(std::sin, expr);
+    return plot::Function(std::sin, expr, simd::getKernels().sin);
+}
+
+[[maybe_unused]]
+static Expression cos(Expression expr)
+{
+    return plot::Function(std::cos, expr, simd::getKernels().cos);
+}
+
+[[maybe_unused]]
+static Expression exp(Expression expr)
+{
+    return plot::Function(std::exp, expr, simd::getKernels().exp);
+}
+
+[[maybe_unused]]
+static Expression log(Expression expr)
+{
+    return plot::Function(std::log, expr, simd::getKernels().log);
 }
 
 
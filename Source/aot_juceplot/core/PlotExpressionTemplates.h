@@ -0,0 +1,217 @@
+#pragma once
+
+/*
+    Expression templates: the same vocabulary as Expression (x, constants, +, *, sin, ...)
+    but every node keeps its full static type, e.g. et::sin(et::x) * 2 is a
+    Mul<Sin<X>, Const>. Nothing is allocated while building the tree and the
+    compiler can inline the whole evaluation into a single loop.
+
+    The tree is erased into an Expression only when it is handed to
+    PlotStream::addPlotData, where it becomes a single node.
+*/
+
+namespace et {
+
+/* Common base of all static nodes, used to constrain the operators */
+struct Node {};
+
+struct X : Node
+{
+    static const bool hasFunctions = false;
+
+    double operator[](double i) const
+    {
+        return i;
+    }
+
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        std::copy(xs, xs + n, ys);
+    }
+};
+
+struct Const : Node
+{
+    static const bool hasFunctions = false;
+
+    Const(double val) : _val(val) { }
+
+    double operator[](double) const
+    {
+        return _val;
+    }
+
+    void evaluate(const double*, double* ys, std::size_t n, Precision) const
+    {
+        std::fill(ys, ys + n, _val);
+    }
+
+private:
+    double _val;
+};
+
+template <typename LhsT, typename RhsT, typename OperationT>
+struct Binary : Node
+{
+    static const bool hasFunctions = LhsT::hasFunctions || RhsT::hasFunctions;
+
+    Binary(LhsT lhs, RhsT rhs) : _lhs(lhs), _rhs(rhs) { }
+
+    double operator[](double i) const
+    {
+        OperationT operation;
+        return operation(_lhs[i], _rhs[i]);
+    }
+
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+    {
+        // One fused loop, unless the subtree has functions with block kernels to use
+        if (precision == EXACT || ! hasFunctions)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                ys[i] = (*this)[xs[i]];
+
+            return;
+        }
+
+        OperationT operation;
+        double rhs[BLOCK_SIZE];
+
+        for (std::size_t offset = 0; offset < n; offset += BLOCK_SIZE)
+        {
+            auto count = std::min(BLOCK_SIZE, n - offset);
+            auto out = ys + offset;
+
+            _lhs.evaluate(xs + offset, out, count, precision);
+            _rhs.evaluate(xs + offset, rhs, count, precision);
+
+            for (std::size_t i = 0; i < count; ++i)
+                out[i] = operation(out[i], rhs[i]);
+        }
+    }
+
+private:
+    LhsT _lhs;
+    RhsT _rhs;
+};
+
+template <typename ExprT, typename FunctionT>
+struct Unary : Node
+{
+    static const bool hasFunctions = true;
+
+    Unary(ExprT expr) : _expr(expr) { }
+
+    double operator[](double i) const
+    {
+        return FunctionT::exact(_expr[i]);
+    }
+
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+    {
+        if (precision == EXACT)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                ys[i] = (*this)[xs[i]];
+
+            return;
+        }
+
+        _expr.evaluate(xs, ys, n, precision);
+        FunctionT::fast()(ys, ys, n);
+    }
+
+private:
+    ExprT _expr;
+};
+
+struct SinFunction
+{
+    static double exact(double v) { return std::sin(v); }
+    static simd::UnaryKernel fast() { return simd::getKernels().sin; }
+};
+
+struct CosFunction
+{
+    static double exact(double v) { return std::cos(v); }
+    static simd::UnaryKernel fast() { return simd::getKernels().cos; }
+};
+
+struct ExpFunction
+{
+    static double exact(double v) { return std::exp(v); }
+    static simd::UnaryKernel fast() { return simd::getKernels().exp; }
+};
+
+struct LogFunction
+{
+    static double exact(double v) { return std::log(v); }
+    static simd::UnaryKernel fast() { return simd::getKernels().log; }
+};
+
+template <typename LhsT, typename RhsT> using Add = Binary<LhsT, RhsT, std::plus<double>>;
+template <typename LhsT, typename RhsT> using Mul = Binary<LhsT, RhsT, std::multiplies<double>>;
+
+template <typename ExprT> using Sin = Unary<ExprT, SinFunction>;
+template <typename ExprT> using Cos = Unary<ExprT, CosFunction>;
+template <typename ExprT> using Exp = Unary<ExprT, ExpFunction>;
+template <typename ExprT> using Log = Unary<ExprT, LogFunction>;
+
+/* Maps operands to nodes: nodes stay as they are, numbers become Const */
+template <typename T, typename = void>
+struct Operand;
+
+template <typename T>
+struct Operand<T, typename std::enable_if<std::is_base_of<Node, T>::value>::type>
+{
+    typedef T Type;
+};
+
+template <typename T>
+struct Operand<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    typedef Const Type;
+};
+
+template <typename LhsT, typename RhsT>
+using EnableIfNode = typename std::enable_if<std::is_base_of<Node, LhsT>::value || std::is_base_of<Node, RhsT>::value>::type;
+
+const static X x {};
+
+template <typename LhsT, typename RhsT, typename = EnableIfNode<LhsT, RhsT>>
+Mul<typename Operand<LhsT>::Type, typename Operand<RhsT>::Type> operator*(const LhsT& lhs, const RhsT& rhs)
+{
+    return Mul<typename Operand<LhsT>::Type, typename Operand<RhsT>::Type>(lhs, rhs);
+}
+
+template <typename LhsT, typename RhsT, typename = EnableIfNode<LhsT, RhsT>>
+Add<typename Operand<LhsT>::Type, typename Operand<RhsT>::Type> operator+(const LhsT& lhs, const RhsT& rhs)
+{
+    return Add<typename Operand<LhsT>::Type, typename Operand<RhsT>::Type>(lhs, rhs);
+}
+
+template <typename ExprT, typename = EnableIfNode<ExprT, ExprT>>
+Sin<ExprT> sin(const ExprT& expr)
+{
+    return Sin<ExprT>(expr);
+}
+
+template <typename ExprT, typename = EnableIfNode<ExprT, ExprT>>
+Cos<ExprT> cos(const ExprT& expr)
+{
+    return Cos<ExprT>(expr);
+}
+
+template <typename ExprT, typename = EnableIfNode<ExprT, ExprT>>
+Exp<ExprT> exp(const ExprT& expr)
+{
+    return Exp<ExprT>(expr);
+}
+
+template <typename ExprT, typename = EnableIfNode<ExprT, ExprT>>
+Log<ExprT> log(const ExprT& expr)
+{
+    return Log<ExprT>(expr);
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/* Where the time of one PlotStream::plot() went, in milliseconds */
+struct FrameStats
+{
+    juce::uint64 frame;         // counted from the first frame recorded
+    double startTime;           // juce::Time::getMillisecondCounterHiRes() when it began
+    double total;
+    double axes;                // drawing or copying the axes
+    double evaluation;          // sampling all curves, which share one program
+    double rasterization;       // turning samples into lines and paths
+    double compositing;         // copying layers and background frames onto the graphics
+    juce::uint64 numSamples;    // curve values computed
+    juce::uint64 numAllocations; // 0 without an allocation counter
+};
+
+/*
+    The last CAPACITY frames, written by the thread that paints and read by any
+    other without locks. Every slot carries the number of the frame it holds,
+    cleared while it is written: a reader copying a slot that changed in the
+    meantime sees the number differ and drops the copy.
+*/
+class FrameStatsRing
+{
+public:
+    static const int CAPACITY = 256;
+    
+    /* Frames recorded since the start */
+    juce::uint64 getNumFrames() const
+    {
+        return _numFrames.load(std::memory_order_acquire);
+    }
+    
+    void push(const FrameStats& stats)
+    {
+        auto& slot = _slots[stats.frame % CAPACITY];
+        
+        slot.frame.store(EMPTY, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.stats = stats;
+        slot.frame.store(stats.frame, std::memory_order_release);
+        
+        _numFrames.store(stats.frame + 1, std::memory_order_release);
+    }
+    
+    /* Copies up to maxFrames of the newest frames into dest, oldest first, and returns their number */
+    int getLatest(FrameStats* dest, int maxFrames) const
+    {
+        auto numFrames = getNumFrames();
+        auto first = numFrames - std::min<juce::uint64>(numFrames, static_cast<juce::uint64>(std::min(maxFrames, CAPACITY)));
+        auto numCopied = 0;
+        
+        for (auto frame = first; frame < numFrames; ++frame)
+        {
+            auto& slot = _slots[frame % CAPACITY];
+            
+            if (slot.frame.load(std::memory_order_acquire) != frame)
+                continue;
+            
+            auto stats = slot.stats;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            
+            if (slot.frame.load(std::memory_order_relaxed) == frame)
+                dest[numCopied++] = stats;
+        }
+        
+        return numCopied;
+    }
+    
+private:
+    static const juce::uint64 EMPTY = ~juce::uint64(0);
+    
+    struct Slot
+    {
+        std::atomic<juce::uint64> frame { EMPTY };
+        FrameStats stats;
+    };
+    
+    Slot _slots[CAPACITY];
+    std::atomic<juce::uint64> _numFrames { 0 };
+};
@@ -0,0 +1,755 @@
+ColumnStore::ColumnStore(std::size_t maxRows, int numColumns)
+    : _numColumns(numColumns), _blocks(((maxRows + BLOCK_ROWS - 1) / BLOCK_ROWS) * numColumns)
+{
+    // A level has an entry for every complete block of its rows, up to the one covering them all
+    std::size_t numRangeBlocks = 0;
+    
+    for (auto blockRows = LEAF_ROWS; maxRows / blockRows > 0; blockRows *= 2)
+    {
+        _levelOffsets.push_back(numRangeBlocks);
+        numRangeBlocks += (maxRows / blockRows + RANGE_BLOCK_SIZE - 1) / RANGE_BLOCK_SIZE;
+    }
+    
+    _ranges.resize(numRangeBlocks * static_cast<std::size_t>(numColumns));
+}
+
+void ColumnStore::allocate(std::size_t numRows)
+{
+    auto numBlocks = (numRows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+    jassert(numBlocks * _numColumns <= _blocks.size());
+    
+    for (; _numBlocks < numBlocks; ++_numBlocks)
+        for (auto column = 0; column < _numColumns; ++column)
+            _blocks[_numBlocks * _numColumns + column].reset(new double[BLOCK_ROWS]);
+}
+
+void ColumnStore::publish(std::size_t numRows)
+{
+    auto from = _numRows.load(std::memory_order_relaxed);
+    
+    // Column 0 is x, which is never summarised
+    parallel::forEach(static_cast<std::size_t>(_numColumns - 1), [this, from, numRows](std::size_t i)
+    {
+        updateRanges(static_cast<int>(i) + 1, from, numRows);
+    });
+    
+    _numRows.store(numRows, std::memory_order_release);
+}
+
+void ColumnStore::updateRanges(int column, std::size_t from, std::size_t to)
+{
+    auto blockRows = LEAF_ROWS;
+    
+    for (std::size_t level = 0; level < _levelOffsets.size(); ++level, blockRows *= 2)
+    {
+        // Entries completed by the rows [from, to)
+        for (auto index = from / blockRows; index < to / blockRows; ++index)
+        {
+            auto& block = _ranges[(_levelOffsets[level] + index / RANGE_BLOCK_SIZE) * _numColumns + column];
+            
+            if (block == nullptr)
+                block.reset(new Range[RANGE_BLOCK_SIZE]);
+            
+            auto range = getRange(column, level, index);
+            
+            if (level == 0)
+            {
+                // Leaves never cross a row block
+                auto ys = &_blocks[(index * LEAF_ROWS / BLOCK_ROWS) * _numColumns + column][index * LEAF_ROWS % BLOCK_ROWS];
+                auto min = std::numeric_limits<double>::infinity();
+                auto max = -min;
+                
+                for (std::size_t i = 0; i < LEAF_ROWS; ++i)
+                {
+                    min = ys[i] < min ? ys[i] : min;
+                    max = ys[i] > max ? ys[i] : max;
+                }
+                
+                *range = { min, max };
+            }
+            else
+            {
+                auto lo = getRange(column, level - 1, 2 * index);
+                auto hi = getRange(column, level - 1, 2 * index + 1);
+                *range = { std::min(lo->min, hi->min), std::max(lo->max, hi->max) };
+            }
+        }
+    }
+}
+
+void ColumnStore::findRange(int column, std::size_t begin, std::size_t end, double& min, double& max) const
+{
+    jassert(column > 0 && end <= getNumRows());
+    
+    min = std::numeric_limits<double>::infinity();
+    max = -min;
+    
+    auto add = [&min, &max](double lo, double hi)
+    {
+        min = lo < min ? lo : min;
+        max = hi > max ? hi : max;
+    };
+    
+    while (begin < end && begin % LEAF_ROWS != 0)
+    {
+        auto y = get(column, begin++);
+        add(y, y);
+    }
+    
+    std::size_t level = 0;
+    auto blockRows = LEAF_ROWS;
+    
+    while (! _levelOffsets.empty() && begin + blockRows <= end)
+    {
+        // Largest aligned block that fits
+        while (level + 1 < _levelOffsets.size() && begin % (blockRows * 2) == 0 && begin + blockRows * 2 <= end)
+        {
+            ++level;
+            blockRows *= 2;
+        }
+        
+        auto range = getRange(column, level, begin / blockRows);
+        add(range->min, range->max);
+        begin += blockRows;
+        
+        while (level > 0 && begin + blockRows > end)
+        {
+            --level;
+            blockRows /= 2;
+        }
+    }
+    
+    for (; begin < end; ++begin)
+    {
+        auto y = get(column, begin);
+        add(y, y);
+    }
+}
+
+/* -------------------------------------------------------- */
+
+double ColumnSamples::getLastX() const
+{
+    auto size = _store->getNumRows();
+    return size == 0 ? -std::numeric_limits<double>::infinity() : _store->get(0, size - 1);
+}
+
+double ColumnSamples::operator[](double x) const
+{
+    auto rows = getRows();
+    return SampleSeries<Rows>(rows)[x];
+}
+
+void ColumnSamples::evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+{
+    auto rows = getRows();
+    SampleSeries<Rows>(rows).evaluate(xs, ys, n);
+}
+
+bool ColumnSamples::envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+{
+    auto rows = getRows();
+    return SampleSeries<Rows>(rows).envelope(edges, numColumns, columns);
+}
+
+/* -------------------------------------------------------- */
+
+// Bytes per chunk, a batch has a chunk for every thread
+static const std::size_t CSV_CHUNK_SIZE = 4 << 20;
+
+static const double POWERS_OF_TEN[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool isCsvDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/*
+    Parses the number at p, whatever the locale. Up to 19 significant digits
+    with a mantissa below 2^53 and a power of ten up to 22 are exact in double
+    arithmetic (Clinger's fast path), anything else is handed to
+    juce::CharacterFunctions, which unlike strtod ignores LC_NUMERIC too.
+    Returns NaN and leaves p alone if there is no number, else p is left
+    after it.
+*/
+static double parseCsvNumber(const char*& p, const char* end)
+{
+    auto start = p;
+    auto q = p;
+    
+    while (q < end && *q == ' ')
+        ++q;
+    
+    auto token = q;
+    auto negative = false;
+    
+    if (q < end && (*q == '-' || *q == '+'))
+        negative = *q++ == '-';
+    
+    std::uint64_t mantissa = 0;
+    auto numSignificant = 0;
+    auto exponent = 0;
+    auto hasDigits = false;
+    auto isExact = true;
+    
+    for (; q < end && isCsvDigit(*q); ++q)
+    {
+        hasDigits = true;
+        
+        if (numSignificant < 19)
+        {
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(*q - '0');
+            numSignificant += mantissa != 0;
+        }
+        else
+        {
+            ++exponent;
+            isExact = isExact && *q == '0';
+        }
+    }
+    
+    if (q < end && *q == '.')
+    {
+        for (++q; q < end && isCsvDigit(*q); ++q)
+        {
+            hasDigits = true;
+            
+            if (numSignificant < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<std::uint64_t>(*q - '0');
+                numSignificant += mantissa != 0;
+                --exponent;
+            }
+            else
+            {
+                isExact = isExact && *q == '0';
+            }
+        }
+    }
+    
+    if (! hasDigits)
+    {
+        p = start;
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    
+    // Exponent, only if it is followed by digits
+    if (q < end && (*q == 'e' || *q == 'E'))
+    {
+        auto next = q + 1;
+        auto negativeExponent = false;
+        
+        if (next < end && (*next == '+' || *next == '-'))
+            negativeExponent = *next++ == '-';
+        
+        if (next < end && isCsvDigit(*next))
+        {
+            auto value = 0;
+            
+            for (q = next; q < end && isCsvDigit(*q); ++q)
+                value = std::min(value * 10 + (*q - '0'), 100000);
+            
+            exponent += negativeExponent ? -value : value;
+        }
+    }
+    
+    p = q;
+    
+    if (isExact && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        auto value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+        return negative ? -value : value;
+    }
+    
+    // The token is copied as the file need not end after it, long ones are rare
+    char buffer[128];
+    std::string longToken;
+    auto length = static_cast<std::size_t>(q - token);
+    auto text = buffer;
+    
+    if (length < sizeof(buffer))
+    {
+        std::memcpy(buffer, token, length);
+        buffer[length] = 0;
+    }
+    else
+    {
+        longToken.assign(token, length);
+        text = &longToken[0];
+    }
+    
+    juce::CharPointer_ASCII pointer(text);
+    return juce::CharacterFunctions::readDoubleValue(pointer);
+}
+
+static const char* findLineEnd(const char* p, const char* end)
+{
+    auto lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+    return lineEnd != nullptr ? lineEnd : end;
+}
+
+static bool isBlankLine(const char* line, const char* lineEnd)
+{
+    return line == lineEnd || (lineEnd - line == 1 && *line == '\r');
+}
+
+/* -------------------------------------------------------- */
+
+struct CsvLoader::State
+{
+    std::unique_ptr<juce::MemoryMappedFile> file;
+    
+    // The rows after the header
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    
+    char separator = ',';
+    juce::StringArray names;
+    std::shared_ptr<ColumnStore> store;
+    
+    std::atomic<bool> cancelled { false };
+    std::atomic<bool> finished { false };
+    
+    std::size_t countRows(const char* chunk, const char* chunkEnd) const
+    {
+        std::size_t numRows = 0;
+        
+        for (auto line = chunk; line < chunkEnd; )
+        {
+            auto lineEnd = findLineEnd(line, chunkEnd);
+            numRows += isBlankLine(line, lineEnd) ? 0 : 1;
+            line = lineEnd + 1;
+        }
+        
+        return numRows;
+    }
+    
+    void parseRows(const char* chunk, const char* chunkEnd, std::size_t row)
+    {
+        auto numColumns = store->getNumColumns();
+        
+        for (auto line = chunk; line < chunkEnd; )
+        {
+            auto lineEnd = findLineEnd(line, chunkEnd);
+            
+            if (! isBlankLine(line, lineEnd))
+            {
+                auto p = line;
+                
+                for (auto column = 0; column < numColumns; ++column)
+                {
+                    auto value = std::numeric_limits<double>::quiet_NaN();
+                    
+                    if (p < lineEnd)
+                    {
+                        value = parseCsvNumber(p, lineEnd);
+                        
+                        // Whatever else is in the field is skipped
+                        while (p < lineEnd && *p != separator)
+                            ++p;
+                        
+                        if (p < lineEnd)
+                            ++p;
+                    }
+                    
+                    store->set(column, row, value);
+                }
+                
+                ++row;
+            }
+            
+            line = lineEnd + 1;
+        }
+    }
+    
+    void load(const std::function<void(double)>& progress)
+    {
+        struct Chunk
+        {
+            const char* begin;
+            const char* end;
+            std::size_t firstRow;
+        };
+        
+        std::vector<Chunk> chunks;
+        auto chunksPerBatch = static_cast<std::size_t>(parallel::getSharedPool().getNumThreads()) + 1;
+        
+        std::size_t numRows = 0;
+        auto pos = begin;
+        auto published = begin;
+        
+        while (pos < end && ! cancelled)
+        {
+            // Chunks of a batch end at line ends
+            chunks.clear();
+            
+            while (chunks.size() < chunksPerBatch && pos < end)
+            {
+                auto chunkEnd = pos + std::min(CSV_CHUNK_SIZE, static_cast<std::size_t>(end - pos));
+                chunkEnd = chunkEnd < end ? std::min(end, findLineEnd(chunkEnd, end) + 1) : end;
+                chunks.push_back({ pos, chunkEnd, 0 });
+                pos = chunkEnd;
+            }
+            
+            parallel::forEach(chunks.size(), [&](std::size_t i)
+            {
+                chunks[i].firstRow = countRows(chunks[i].begin, chunks[i].end);
+            });
+            
+            // Counts to the first row of every chunk
+            for (auto& chunk : chunks)
+            {
+                auto count = chunk.firstRow;
+                chunk.firstRow = numRows;
+                numRows += count;
+            }
+            
+            store->allocate(numRows);
+            
+            parallel::forEach(chunks.size(), [&](std::size_t i)
+            {
+                if (! cancelled)
+                    parseRows(chunks[i].begin, chunks[i].end, chunks[i].firstRow);
+            });
+            
+            if (cancelled)
+                break;
+            
+            store->publish(numRows);
+            published = pos;
+            
+            if (progress && ! cancelled)
+                progress(static_cast<double>(pos - begin) / static_cast<double>(end - begin));
+        }
+        
+        // A cancel after the last batch leaves the file loaded
+        finished = published == end;
+        
+        if (progress && finished && ! cancelled)
+            progress(1);
+    }
+};
+
+class CsvLoader::LoadJob : public juce::ThreadPoolJob
+{
+public:
+    LoadJob(std::shared_ptr<State> state, std::function<void(double)> progress)
+        : ThreadPoolJob("CSV loader"), _state(std::move(state)), _progress(std::move(progress))
+    {
+    }
+    
+    JobStatus runJob() override
+    {
+        _state->load(_progress);
+        return jobHasFinished;
+    }
+    
+private:
+    std::shared_ptr<State> _state;
+    std::function<void(double)> _progress;
+};
+
+CsvLoader::CsvLoader()
+{
+}
+
+CsvLoader::~CsvLoader()
+{
+    cancel();
+}
+
+juce::Result CsvLoader::open(const juce::File& file)
+{
+    cancel();
+    
+    auto state = std::make_shared<State>();
+    state->file.reset(new juce::MemoryMappedFile(file, juce::MemoryMappedFile::readOnly));
+    
+    auto data = static_cast<const char*>(state->file->getData());
+    if (data == nullptr)
+        return juce::Result::fail("Could not open " + file.getFullPathName());
+    
+    state->begin = data;
+    state->end = data + state->file->getSize();
+    
+    // The first line tells the separator, the number of columns and maybe their names
+    while (state->begin < state->end && isBlankLine(state->begin, findLineEnd(state->begin, state->end)))
+        state->begin = findLineEnd(state->begin, state->end) + 1;
+    
+    auto line = state->begin;
+    auto lineEnd = findLineEnd(line, state->end);
+    
+    if (line >= lineEnd)
+        return juce::Result::fail(file.getFullPathName() + " is empty");
+    
+    for (auto separator : { ',', ';', '\t' })
+    {
+        if (std::find(line, lineEnd, separator) != lineEnd)
+        {
+            state->separator = separator;
+            break;
+        }
+    }
+    
+    auto numColumns = 1 + static_cast<int>(std::count(line, lineEnd, state->separator));
+    
+    auto p = line;
+    parseCsvNumber(p, lineEnd);
+    
+    if (p == line)
+    {
+        auto header = juce::String(juce::CharPointer_UTF8(line), juce::CharPointer_UTF8(lineEnd)).trim();
+        state->names = juce::StringArray::fromTokens(header, juce::String::charToString(state->separator), "\"");
+        state->names.trim();
+        state->names.remove(0);
+        state->begin = std::min(state->end, lineEnd + 1);
+    }
+    
+    while (state->names.size() < numColumns - 1)
+        state->names.add("Channel " + juce::String(state->names.size() + 1));
+    
+    // A row takes at least a digit and a line end
+    auto maxRows = static_cast<std::size_t>(state->end - state->begin) / 2 + 1;
+    state->store = std::make_shared<ColumnStore>(maxRows, numColumns);
+    
+    _state = state;
+    return juce::Result::ok();
+}
+
+void CsvLoader::start(std::function<void(double)> progress)
+{
+    jassert(_state != nullptr && _job == nullptr);
+    
+    // Kept until cancel(), so that it can be waited for
+    _job.reset(new LoadJob(_state, std::move(progress)));
+    parallel::getSharedPool().addJob(_job.get(), false);
+}
+
+void CsvLoader::cancel()
+{
+    if (_state != nullptr)
+        _state->cancelled = true;
+    
+    // A queued job never runs, a running one returns after its batch
+    if (_job != nullptr)
+    {
+        parallel::getSharedPool().removeJob(_job.get(), true, -1);
+        _job = nullptr;
+    }
+}
+
+bool CsvLoader::isFinished() const
+{
+    return _state != nullptr && _state->finished;
+}
+
+bool CsvLoader::isCancelled() const
+{
+    return _state != nullptr && _state->cancelled && ! _state->finished;
+}
+
+int CsvLoader::getNumChannels() const
+{
+    return _state != nullptr ? _state->store->getNumColumns() - 1 : 0;
+}
+
+juce::String CsvLoader::getChannelName(int channel) const
+{
+    return _state != nullptr ? _state->names[channel] : juce::String();
+}
+
+ColumnSamples CsvLoader::getChannel(int channel) const
+{
+    jassert(channel >= 0 && channel < getNumChannels());
+    return { _state->store, channel + 1 };
+}
+
+/************************* TESTS ***************************/
+
+#if JUCE_UNIT_TESTS
+
+class LoaderTests : public juce::UnitTest
+{
+public:
+    LoaderTests() : juce::UnitTest("aot_juceplot CSV loader")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest("Numbers on the fast path are those of strtod");
+
+        std::string locale = std::setlocale(LC_NUMERIC, nullptr);
+        std::setlocale(LC_NUMERIC, "C");
+
+        juce::Random random(0x5eed);
+        auto numWrong = 0;
+
+        for (auto i = 0; i < 20000; ++i)
+        {
+            // Up to 15 digits with a point among them, and a power of ten within the table
+            auto digits = juce::String(random.nextInt64() % 1000000000000000LL).trimCharactersAtStart("-");
+            auto numFraction = random.nextInt(digits.length() + 1);
+            auto exponent = numFraction - 22 + random.nextInt(45 - numFraction);
+
+            auto text = (random.nextBool() ? "-" : "") + digits.dropLastCharacters(numFraction);
+            if (numFraction > 0)
+                text << "." << digits.getLastCharacters(numFraction);
+            if (exponent != 0)
+                text << "e" << exponent;
+
+            numWrong += parse(text) == std::strtod(text.toRawUTF8(), nullptr) ? 0 : 1;
+        }
+
+        expectEquals(numWrong, 0);
+
+        beginTest("Other numbers are read whatever the locale");
+
+        expectFallbacks();
+
+        // Only where the system has such a locale
+        if (std::setlocale(LC_NUMERIC, "de_DE.UTF-8") != nullptr || std::setlocale(LC_NUMERIC, "de_DE") != nullptr)
+            expectFallbacks();
+
+        std::setlocale(LC_NUMERIC, locale.c_str());
+
+        beginTest("Fields without a number are NaN");
+
+        for (auto text : { "", "x", "-", ".", "e5", "+", " ;1" })
+        {
+            auto p = text;
+            expect(std::isnan(parseCsvNumber(p, text + std::strlen(text))), text);
+            expect(p == text, text);
+        }
+
+        auto text = "1.5e;";
+        auto p = text;
+        expectEquals(parseCsvNumber(p, text + 5), 1.5);
+        expect(p == text + 3);
+
+        beginTest("A header line, CRLF line ends and blank lines");
+
+        auto file = writeFile("time;a;b\r\n0;x;1\r\n\r\n1;2;3\r\n2;4;5");
+
+        {
+            CsvLoader loader;
+            expect(loader.open(file).wasOk());
+            load(loader);
+
+            expectEquals(loader.getNumChannels(), 2);
+            expectEquals(loader.getChannelName(0), juce::String("a"));
+            expectEquals(loader.getChannelName(1), juce::String("b"));
+
+            auto a = loader.getChannel(0);
+            auto b = loader.getChannel(1);
+            expectEquals(static_cast<int>(a.size()), 3);
+            expect(std::isnan(a[0]));
+            expectEquals(a[1.5], 3.0);
+            expectEquals(b[0.5], 2.0);
+            expectEquals(b.getLastX(), 2.0);
+        }
+
+        beginTest("Tabs and no header");
+
+        file.deleteFile();
+        file = writeFile("0\t1\n1\t2\n");
+
+        {
+            CsvLoader loader;
+            expect(loader.open(file).wasOk());
+            load(loader);
+
+            expectEquals(loader.getNumChannels(), 1);
+            expectEquals(loader.getChannelName(0), juce::String("Channel 1"));
+            expectEquals(loader.getChannel(0)[0.5], 1.5);
+        }
+
+        beginTest("Cancelling a load");
+
+        file.deleteFile();
+
+        std::string rows;
+        for (auto i = 0; i < 200000; ++i)
+            rows += std::to_string(i) + "," + std::to_string(i % 100) + "\n";
+
+        file = writeFile(rows.c_str());
+
+        {
+            CsvLoader loader;
+            expect(loader.open(file).wasOk());
+
+            std::atomic<bool> cancelled { false };
+            std::atomic<bool> calledAfterCancel { false };
+
+            loader.start([&](double) { calledAfterCancel = calledAfterCancel || cancelled; });
+            loader.cancel();
+            cancelled = true;
+
+            auto numRows = loader.getChannel(0).size();
+            juce::Thread::sleep(20);
+
+            expect(! calledAfterCancel);
+            expect(loader.isFinished() != loader.isCancelled());
+            expectEquals(static_cast<int>(loader.getChannel(0).size()), static_cast<int>(numRows));
+        }
+
+        file.deleteFile();
+    }
+
+private:
+    static double parse(const juce::String& text)
+    {
+        auto p = text.toRawUTF8();
+        return parseCsvNumber(p, p + text.getNumBytesAsUTF8());
+    }
+
+    /* More than 19 digits, large powers of ten and tokens longer than any buffer */
+    void expectFallbacks()
+    {
+        struct Case { juce::String text; double value; };
+
+        Case cases[] =
+        {
+            { "6.02e23", 6.02e23 },
+            { "-1.5e-30", -1.5e-30 },
+            { "12345678901234567890123", 1.2345678901234567890123e22 },
+            { "0.12345678901234567890123", 0.12345678901234567890123 },
+            { "1e300", 1e300 },
+            { "0." + juce::String::repeatedString("0", 150) + "25", 2.5e-151 },
+            { "1" + juce::String::repeatedString("0", 200), 1e200 }
+        };
+
+        for (auto& c : cases)
+            expect(std::abs(parse(c.text) - c.value) <= 1e-14 * std::abs(c.value), c.text + " read as " + juce::String(parse(c.text)));
+    }
+
+    static juce::File writeFile(const char* text)
+    {
+        auto file = juce::File::createTempFile(".csv");
+        juce::FileOutputStream stream(file);
+        stream.write(text, std::strlen(text));
+        return file;
+    }
+
+    static void load(CsvLoader& loader)
+    {
+        std::atomic<double> last { 0 };
+        loader.start([&last](double progress) { last = progress; });
+
+        while (! loader.isFinished() && ! loader.isCancelled())
+            juce::Thread::sleep(1);
+
+        // progress is called once more after the rows are complete
+        while (last != 1)
+            juce::Thread::sleep(1);
+    }
+};
+
+static LoaderTests loaderTests;
+
+#endif
@@ -0,0 +1,185 @@
+#pragma once
+
+/*
+    Columns of doubles filled in row order by a loader while plots read them.
+    Rows live in blocks that never move once allocated, and become visible
+    only when all rows before them are complete, so a reader sees whole rows.
+    Every column but x keeps a pyramid of the min and max of its rows, with
+    the layout of a MappedSamples LOD file, extended as rows are published.
+*/
+class ColumnStore
+{
+public:
+    /* maxRows bounds the number of rows ever stored, blocks are allocated as rows arrive */
+    ColumnStore(std::size_t maxRows, int numColumns);
+    
+    int getNumColumns() const
+    {
+        return _numColumns;
+    }
+    
+    /* Rows complete and readable */
+    std::size_t getNumRows() const
+    {
+        return _numRows.load(std::memory_order_acquire);
+    }
+    
+    double get(int column, std::size_t row) const
+    {
+        return _blocks[(row / BLOCK_ROWS) * _numColumns + column][row % BLOCK_ROWS];
+    }
+    
+    /* Loader side: makes room for rows below numRows */
+    void allocate(std::size_t numRows);
+    
+    /* Range of the values of column over the published rows [begin, end), NaN is skipped */
+    void findRange(int column, std::size_t begin, std::size_t end, double& min, double& max) const;
+    
+    /* Loader side: rows may be set in any order until they are published */
+    void set(int column, std::size_t row, double value)
+    {
+        _blocks[(row / BLOCK_ROWS) * _numColumns + column][row % BLOCK_ROWS] = value;
+    }
+    
+    /* Loader side: rows below numRows are complete, extends the pyramids over them */
+    void publish(std::size_t numRows);
+    
+private:
+    struct Range
+    {
+        double min;
+        double max;
+    };
+    
+    static const std::size_t BLOCK_ROWS = 1 << 16;
+    static const std::size_t LEAF_ROWS = 64;
+    static const std::size_t RANGE_BLOCK_SIZE = 1 << 10;
+    
+    /* Entry of level covering the rows [index, index + 1) * (LEAF_ROWS << level) */
+    Range* getRange(int column, std::size_t level, std::size_t index) const
+    {
+        return _ranges[(_levelOffsets[level] + index / RANGE_BLOCK_SIZE) * _numColumns + column].get() + index % RANGE_BLOCK_SIZE;
+    }
+    
+    void updateRanges(int column, std::size_t from, std::size_t to);
+    
+    int _numColumns;
+    std::size_t _numBlocks = 0;
+    std::vector<std::unique_ptr<double[]>> _blocks;
+    std::atomic<std::size_t> _numRows { 0 };
+    
+    // Entries of complete row blocks only, in blocks that never move either
+    std::vector<std::size_t> _levelOffsets;
+    std::vector<std::unique_ptr<Range[]>> _ranges;
+};
+
+/*
+    One column of a ColumnStore against its first one, as x. It grows while
+    the store is being loaded, every call works on the rows complete when it
+    starts. envelope() reads the pyramid of the store, so a column costs
+    O(log n) however many rows it covers.
+*/
+class ColumnSamples
+{
+public:
+    ColumnSamples(std::shared_ptr<const ColumnStore> store, int column) : _store(std::move(store)), _column(column)
+    {
+    }
+    
+    std::size_t size() const
+    {
+        return _store->getNumRows();
+    }
+    
+    /* x of the newest complete row, -infinity while there is none */
+    double getLastX() const;
+    
+    double operator[](double x) const;
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const;
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const;
+    
+private:
+    /* The rows complete when a call starts, for SampleSeries */
+    struct Rows
+    {
+        std::size_t size() const            { return numRows; }
+        double getX(std::size_t row) const  { return store.get(0, row); }
+        double getY(std::size_t row) const  { return store.get(column, row); }
+        
+        void findRange(std::size_t begin, std::size_t end, double& min, double& max) const
+        {
+            store.findRange(column, begin, end, min, max);
+        }
+        
+        const ColumnStore& store;
+        int column;
+        std::size_t numRows;
+    };
+    
+    Rows getRows() const
+    {
+        return { *_store, _column, _store->getNumRows() };
+    }
+    
+    std::shared_ptr<const ColumnStore> _store;
+    int _column;
+};
+
+/*
+    Loads a CSV file on the shared pool. The file is mapped and walked in
+    batches of chunks ending at line ends, one chunk per thread: the rows of
+    every chunk are counted in parallel, then parsed in parallel straight to
+    their place in a ColumnStore. A batch becomes visible as soon as it is
+    parsed, so plots show the start of a file while the rest is loading.
+
+    The first column is x, increasing, every other column a channel. Columns
+    are separated by ',', ';' or tabs, whichever the first line uses. A first
+    line which does not start with a number names the channels. Fields that
+    are not numbers are NaN.
+*/
+class CsvLoader
+{
+public:
+    CsvLoader();
+    
+    /* Cancels a load still running */
+    ~CsvLoader();
+    
+    /* Maps file and reads its first line */
+    juce::Result open(const juce::File& file);
+    
+    /*
+        Loads the rest on a thread of the shared pool. progress is called on
+        that thread after every batch, with the part of the file done so far,
+        and once more with 1 when the whole file is loaded, never after the
+        load is cancelled. Calling
+        PlotComponent::dataChanged() from there, on the message thread, shows
+        the rows loaded so far.
+    */
+    void start(std::function<void(double)> progress = nullptr);
+    
+    /* Stops the load and waits for its thread to leave it, the rows loaded so far stay */
+    void cancel();
+    
+    /* True once every row of the file is loaded */
+    bool isFinished() const;
+    
+    /* True if the load was stopped before the end of the file */
+    bool isCancelled() const;
+    
+    int getNumChannels() const;
+    
+    juce::String getChannelName(int channel) const;
+    
+    /* The samples of channel, growing during the load, e.g. for PlotStream::addPlotData() */
+    ColumnSamples getChannel(int channel) const;
+    
+private:
+    struct State;
+    class LoadJob;
+    
+    std::shared_ptr<State> _state;
+    std::unique_ptr<LoadJob> _job;
+};
@@ -0,0 +1,79 @@
+namespace parallel {
+
+SharedPool::SharedPool() : ThreadPool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+}
+
+SharedPool& getSharedPool()
+{
+    static SharedPool pool;
+    return pool;
+}
+
+/* A forEach in progress, helpers which start after it is done find nothing left */
+struct Work
+{
+    Work(std::size_t count, const std::function<void(std::size_t)>& task) : count(count), task(task)
+    {
+    }
+
+    void run()
+    {
+        for (auto i = next++; i < count; i = next++)
+        {
+            task(i);
+
+            if (++numDone == count)
+                finished.signal();
+        }
+    }
+
+    const std::size_t count;
+    const std::function<void(std::size_t)>& task;
+    std::atomic<std::size_t> next { 0 };
+    std::atomic<std::size_t> numDone { 0 };
+    juce::WaitableEvent finished;
+};
+
+class Helper : public juce::ThreadPoolJob
+{
+public:
+    Helper(std::shared_ptr<Work> work) : ThreadPoolJob("Plot helper"), _work(std::move(work))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        _work->run();
+        return jobHasFinished;
+    }
+
+private:
+    std::shared_ptr<Work> _work;
+};
+
+void forEach(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    if (count <= 1)
+    {
+        if (count == 1)
+            task(0);
+
+        return;
+    }
+
+    auto& pool = getSharedPool();
+    auto work = std::make_shared<Work>(count, task);
+
+    auto numHelpers = std::min(count - 1, static_cast<std::size_t>(pool.getNumThreads()));
+    for (std::size_t i = 0; i < numHelpers; ++i)
+        pool.addJob(new Helper(work), true);
+
+    work->run();
+
+    // Tasks still running were taken by helpers, which are busy with them
+    while (work->numDone.load() < count)
+        work->finished.wait();
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+    Work spread over one thread pool shared by all plots in the process. The
+    thread asking for work to be done takes part in it, so work can also be
+    split from inside a job of the pool: it never waits for a thread to be free.
+*/
+
+namespace parallel {
+
+/* The shared pool, one thread less than there are cores: the caller is the last */
+class SharedPool : public juce::ThreadPool
+{
+public:
+    SharedPool();
+};
+
+/*
+    Created on first use and kept until the process exits, so it is never
+    destroyed by one of its own jobs or rebuilt for every forEach.
+*/
+SharedPool& getSharedPool();
+
+/*
+    Calls task(i) for every i in [0, count) and returns once all calls have
+    returned. Indices are taken one at a time by the calling thread and by the
+    pool threads that are free, so slow tasks do not hold the others up.
+*/
+void forEach(std::size_t count, const std::function<void(std::size_t)>& task);
+
+}
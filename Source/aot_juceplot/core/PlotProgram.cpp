@@ -0,0 +1,895 @@
+/************************* BUILDER ***************************/
+
+/*
+    Collects instructions in SSA form, every instruction defines a new value.
+    Operations on constants are folded and an instruction equal to an earlier one
+    returns the earlier value, so the program is a DAG rather than a tree.
+    finish() then drops dead values and maps the rest to as few registers as possible.
+*/
+class Program::Builder : public ExpressionCompiler
+{
+public:
+    /* Precision of the calls that follow, FAST leaves the choice to evaluation */
+    void setPrecision(Precision precision)
+    {
+        _precision = precision;
+    }
+
+    int loadX() override
+    {
+        return emit(makeInstruction(LOAD_X));
+    }
+
+    int constant(double value) override
+    {
+        auto instruction = makeInstruction(LOAD_CONST);
+        instruction.value = value;
+        return emit(instruction);
+    }
+
+    int binary(OpCode op, int lhs, int rhs) override
+    {
+        if (isConstant(lhs) && isConstant(rhs))
+            return constant(apply(op, _code[lhs].value, _code[rhs].value));
+
+        // Both orders of a commutative operation are the same value
+        if ((op == ADD || op == MUL) && rhs < lhs)
+            std::swap(lhs, rhs);
+
+        auto instruction = makeInstruction(op);
+        instruction.lhs = lhs;
+        instruction.rhs = rhs;
+        return emit(instruction);
+    }
+
+    int unary(OpCode op, int operand) override
+    {
+        if (isConstant(operand))
+            return constant(apply(op, _code[operand].value, 0));
+
+        auto instruction = makeInstruction(op);
+        instruction.lhs = operand;
+        return emit(instruction);
+    }
+
+    int call(Func func, simd::UnaryKernel fastFunc, int operand) override
+    {
+        if (isConstant(operand))
+            return constant(func(_code[operand].value));
+
+        auto instruction = makeInstruction(CALL);
+        instruction.lhs = operand;
+        instruction.func = func;
+        instruction.fastFunc = fastFunc;
+        instruction.precision = fastFunc ? _precision : EXACT;
+        return emit(instruction);
+    }
+
+    int expression(const Expression& expr) override
+    {
+        for (int i = 0; i < static_cast<int>(_code.size()); ++i)
+        {
+            auto& instruction = _code[i];
+            if (instruction.op == EVAL && instruction.precision == _precision
+                && _expressions[instruction.expression].isSameNode(expr))
+                return i;
+        }
+
+        auto instruction = makeInstruction(EVAL);
+        instruction.precision = _precision;
+        instruction.expression = static_cast<int>(_expressions.size());
+        _expressions.push_back(expr);
+        return emit(instruction);
+    }
+
+    void finish(std::vector<int> results, Program& program)
+    {
+        removeDeadCode(results);
+
+        auto numValues = static_cast<int>(_code.size());
+
+        // Index of the last instruction reading each value
+        std::vector<int> lastUse(numValues, -1);
+        for (int i = 0; i < numValues; ++i)
+        {
+            if (_code[i].lhs >= 0) lastUse[_code[i].lhs] = i;
+            if (_code[i].rhs >= 0) lastUse[_code[i].rhs] = i;
+        }
+        for (auto result : results)
+            lastUse[result] = numValues;
+
+        std::vector<int> registerOf(numValues, -1);
+        std::vector<int> freeRegisters;
+        int numRegisters = 0;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            auto& instruction = _code[i];
+
+            // Operands dying here give their register back before the target is
+            // picked, all operations work element-wise so in-place is fine
+            if (instruction.lhs >= 0)
+            {
+                auto value = instruction.lhs;
+                instruction.lhs = registerOf[value];
+                if (lastUse[value] == i)
+                    freeRegisters.push_back(instruction.lhs);
+            }
+
+            if (instruction.rhs >= 0)
+            {
+                auto value = instruction.rhs;
+                instruction.rhs = registerOf[value];
+                if (lastUse[value] == i && instruction.rhs != instruction.lhs)
+                    freeRegisters.push_back(instruction.rhs);
+            }
+
+            if (freeRegisters.empty())
+            {
+                registerOf[i] = numRegisters++;
+            }
+            else
+            {
+                registerOf[i] = freeRegisters.back();
+                freeRegisters.pop_back();
+            }
+
+            instruction.target = registerOf[i];
+
+            // Unused operands point at a valid register, evaluation never reads them
+            instruction.lhs = std::max(0, instruction.lhs);
+            instruction.rhs = std::max(0, instruction.rhs);
+
+            // Values nobody reads are dead right away
+            if (lastUse[i] < 0)
+                freeRegisters.push_back(registerOf[i]);
+        }
+
+        for (auto& result : results)
+            result = registerOf[result];
+
+        program._code = std::move(_code);
+        program._expressions = std::move(_expressions);
+        program._results = std::move(results);
+        program._numRegisters = numRegisters;
+    }
+
+private:
+    typedef std::tuple<int, int, int, std::uint64_t, std::uintptr_t, std::uintptr_t, int, int> Key;
+
+    static Instruction makeInstruction(OpCode op)
+    {
+        return { op, 0, -1, -1, 0, nullptr, nullptr, EXACT, -1 };
+    }
+
+    static double apply(OpCode op, double lhs, double rhs)
+    {
+        switch (op)
+        {
+            case ADD: return lhs + rhs;
+            case SUB: return lhs - rhs;
+            case MUL: return lhs * rhs;
+            case DIV: return lhs / rhs;
+            case NEG: return -lhs;
+            case POW: return std::pow(lhs, rhs);
+            default:  jassertfalse; return 0;
+        }
+    }
+
+    bool isConstant(int value) const
+    {
+        return _code[value].op == LOAD_CONST;
+    }
+
+    static Key makeKey(const Instruction& instruction)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &instruction.value, sizeof(bits));
+
+        return Key(instruction.op, instruction.lhs, instruction.rhs, bits,
+                   reinterpret_cast<std::uintptr_t>(instruction.func),
+                   reinterpret_cast<std::uintptr_t>(instruction.fastFunc),
+                   instruction.precision, instruction.expression);
+    }
+
+    int emit(const Instruction& instruction)
+    {
+        auto key = makeKey(instruction);
+        auto known = _values.find(key);
+        if (known != _values.end())
+            return known->second;
+
+        _code.push_back(instruction);
+        auto value = static_cast<int>(_code.size()) - 1;
+        _values.emplace(key, value);
+        return value;
+    }
+
+    /* Drops values no result depends on, e.g. the operands of folded constants */
+    void removeDeadCode(std::vector<int>& results)
+    {
+        auto numValues = static_cast<int>(_code.size());
+
+        std::vector<bool> live(numValues, false);
+        for (auto result : results)
+            live[result] = true;
+
+        for (int i = numValues - 1; i >= 0; --i)
+        {
+            if (! live[i])
+                continue;
+
+            if (_code[i].lhs >= 0) live[_code[i].lhs] = true;
+            if (_code[i].rhs >= 0) live[_code[i].rhs] = true;
+        }
+
+        std::vector<int> renamed(numValues, -1);
+        std::vector<Instruction> code;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            if (! live[i])
+                continue;
+
+            auto instruction = _code[i];
+            if (instruction.lhs >= 0) instruction.lhs = renamed[instruction.lhs];
+            if (instruction.rhs >= 0) instruction.rhs = renamed[instruction.rhs];
+
+            renamed[i] = static_cast<int>(code.size());
+            code.push_back(instruction);
+        }
+
+        for (auto& result : results)
+            result = renamed[result];
+
+        _code = std::move(code);
+        _values.clear();
+    }
+
+    std::vector<Instruction> _code;
+    std::vector<Expression> _expressions;
+    std::map<Key, int> _values;
+    Precision _precision = FAST;
+};
+
+/************************* PARSER ***************************/
+
+/*
+    Recursive descent over the grammar
+
+        sum     := product (('+' | '-') product)*
+        product := unary (('*' | '/') unary)*
+        unary   := '-' unary | power
+        power   := primary ('^' unary)?
+        primary := number | name | name '(' sum ')' | '(' sum ')'
+*/
+class Program::Parser
+{
+public:
+    Parser(const juce::String& text, Builder& builder)
+    : _text(text.toStdString()), _builder(builder)
+    {}
+
+    juce::Result parse(int& result)
+    {
+        result = parseSum();
+
+        skipWhitespace();
+        if (_error.isEmpty() && _pos < _text.size())
+            fail("Unexpected '" + juce::String::charToString(_text[_pos]) + "'");
+
+        return _error.isEmpty() ? juce::Result::ok() : juce::Result::fail(_error);
+    }
+
+private:
+    struct Builtin
+    {
+        const char* name;
+        Func func;
+        simd::UnaryKernel fastFunc;
+    };
+
+    static double abs(double v) { return std::abs(v); }
+
+    static bool isDigit(char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }
+    static bool isAlpha(char c) { return std::isalpha(static_cast<unsigned char>(c)) != 0; }
+    static bool isAlphaNumeric(char c) { return std::isalnum(static_cast<unsigned char>(c)) != 0; }
+
+    const Builtin* findBuiltin(const std::string& name) const
+    {
+        auto& kernels = simd::getKernels();
+        static const Builtin builtins[] = {
+            { "sin",  std::sin,  kernels.sin },
+            { "cos",  std::cos,  kernels.cos },
+            { "tan",  std::tan,  nullptr },
+            { "exp",  std::exp,  kernels.exp },
+            { "log",  std::log,  kernels.log },
+            { "sqrt", std::sqrt, nullptr },
+            { "abs",  abs,       nullptr }
+        };
+
+        for (auto& builtin : builtins)
+        {
+            if (name == builtin.name)
+                return &builtin;
+        }
+
+        return nullptr;
+    }
+
+    int parseSum()
+    {
+        auto lhs = parseProduct();
+
+        while (_error.isEmpty())
+        {
+            if (accept('+'))
+                lhs = _builder.binary(Builder::ADD, lhs, parseProduct());
+            else if (accept('-'))
+                lhs = _builder.binary(Builder::SUB, lhs, parseProduct());
+            else
+                break;
+        }
+
+        return lhs;
+    }
+
+    int parseProduct()
+    {
+        auto lhs = parseUnary();
+
+        while (_error.isEmpty())
+        {
+            if (accept('*'))
+                lhs = _builder.binary(Builder::MUL, lhs, parseUnary());
+            else if (accept('/'))
+                lhs = _builder.binary(Builder::DIV, lhs, parseUnary());
+            else
+                break;
+        }
+
+        return lhs;
+    }
+
+    int parseUnary()
+    {
+        if (accept('-'))
+            return _builder.unary(Builder::NEG, parseUnary());
+
+        return parsePower();
+    }
+
+    int parsePower()
+    {
+        auto base = parsePrimary();
+
+        if (_error.isEmpty() && accept('^'))
+            return _builder.binary(Builder::POW, base, parseUnary());
+
+        return base;
+    }
+
+    int parsePrimary()
+    {
+        if (! _error.isEmpty())
+            return 0;
+
+        skipWhitespace();
+
+        if (_pos >= _text.size())
+            return fail("Unexpected end of expression");
+
+        if (accept('('))
+        {
+            auto value = parseSum();
+            expect(')');
+            return value;
+        }
+
+        auto c = _text[_pos];
+
+        if (isDigit(c) || c == '.')
+            return parseNumber();
+
+        if (isAlpha(c))
+            return parseName();
+
+        return fail("Unexpected '" + juce::String::charToString(c) + "'");
+    }
+
+    int parseNumber()
+    {
+        auto start = _pos;
+        auto numDigits = skipDigits();
+
+        if (_pos < _text.size() && _text[_pos] == '.')
+        {
+            ++_pos;
+            numDigits += skipDigits();
+        }
+
+        if (numDigits == 0)
+            return fail("Expected digits");
+
+        if (_pos < _text.size() && _text[_pos] == '.')
+            return fail("Unexpected '.'");
+
+        // Exponent, only if it is followed by digits
+        if (_pos < _text.size() && (_text[_pos] == 'e' || _text[_pos] == 'E'))
+        {
+            auto next = _pos + 1;
+            if (next < _text.size() && (_text[next] == '+' || _text[next] == '-'))
+                ++next;
+
+            if (next < _text.size() && isDigit(_text[next]))
+            {
+                _pos = next;
+                while (_pos < _text.size() && isDigit(_text[_pos]))
+                    ++_pos;
+            }
+        }
+
+        auto literal = juce::String(_text.substr(start, _pos - start));
+        return _builder.constant(literal.getDoubleValue());
+    }
+
+    std::size_t skipDigits()
+    {
+        auto start = _pos;
+
+        while (_pos < _text.size() && isDigit(_text[_pos]))
+            ++_pos;
+
+        return _pos - start;
+    }
+
+    int parseName()
+    {
+        auto start = _pos;
+        while (_pos < _text.size() && isAlphaNumeric(_text[_pos]))
+            ++_pos;
+
+        auto name = _text.substr(start, _pos - start);
+
+        if (name == "x")
+            return _builder.loadX();
+
+        if (name == "pi")
+            return _builder.constant(juce::MathConstants<double>::pi);
+
+        if (name == "e")
+            return _builder.constant(juce::MathConstants<double>::euler);
+
+        auto builtin = findBuiltin(name);
+        if (builtin == nullptr)
+            return fail("Unknown name '" + juce::String(name) + "'");
+
+        expect('(');
+        auto argument = parseSum();
+        expect(')');
+
+        return _builder.call(builtin->func, builtin->fastFunc, argument);
+    }
+
+    void skipWhitespace()
+    {
+        while (_pos < _text.size() && std::isspace(static_cast<unsigned char>(_text[_pos])))
+            ++_pos;
+    }
+
+    bool accept(char c)
+    {
+        skipWhitespace();
+
+        if (_pos < _text.size() && _text[_pos] == c)
+        {
+            ++_pos;
+            return true;
+        }
+
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (_error.isEmpty() && ! accept(c))
+            fail("Expected '" + juce::String::charToString(c) + "'");
+    }
+
+    int fail(const juce::String& message)
+    {
+        if (_error.isEmpty())
+            _error = message + " at position " + juce::String(static_cast<int>(_pos));
+
+        // Keeps the SSA indices valid for the rest of the (abandoned) parse
+        return _builder.constant(0);
+    }
+
+    std::string _text;
+    std::size_t _pos = 0;
+    Builder& _builder;
+    juce::String _error;
+};
+
+/************************* PROGRAM ***************************/
+
+juce::Result Program::parse(const juce::String& text, Program& program)
+{
+    Builder builder;
+    Parser parser(text, builder);
+
+    int result;
+    auto status = parser.parse(result);
+    if (status.wasOk())
+        builder.finish({ result }, program);
+
+    return status;
+}
+
+Program Program::compile(const Expression& expression)
+{
+    Builder builder;
+    auto result = expression.compile(builder);
+
+    Program program;
+    builder.finish({ result }, program);
+    return program;
+}
+
+Program Program::compile(const std::vector<PlotData>& plotData)
+{
+    Builder builder;
+    std::vector<int> results;
+
+    for (auto& data : plotData)
+    {
+        builder.setPrecision(data.precision);
+        results.push_back(data.expr.compile(builder));
+    }
+
+    Program program;
+    builder.finish(std::move(results), program);
+    return program;
+}
+
+int Program::compile(ExpressionCompiler& compiler) const
+{
+    if (_results.empty())
+        return -1;
+
+    // Replays the instructions, tracking which value each register holds
+    std::vector<int> valueOf(_numRegisters, -1);
+
+    for (auto& instruction : _code)
+    {
+        auto lhs = valueOf[instruction.lhs];
+        auto rhs = valueOf[instruction.rhs];
+        int value;
+
+        switch (instruction.op)
+        {
+            case ExpressionCompiler::LOAD_X:
+                value = compiler.loadX();
+                break;
+
+            case ExpressionCompiler::LOAD_CONST:
+                value = compiler.constant(instruction.value);
+                break;
+
+            case ExpressionCompiler::NEG:
+                value = compiler.unary(instruction.op, lhs);
+                break;
+
+            case ExpressionCompiler::CALL:
+                value = compiler.call(instruction.func, instruction.precision == FAST ? instruction.fastFunc : nullptr, lhs);
+                break;
+
+            case ExpressionCompiler::EVAL:
+                value = compiler.expression(_expressions[instruction.expression]);
+                break;
+
+            default:
+                value = compiler.binary(instruction.op, lhs, rhs);
+                break;
+        }
+
+        valueOf[instruction.target] = value;
+    }
+
+    return valueOf[_results[0]];
+}
+
+void Program::setOutput(int output, const Program& source, Precision precision)
+{
+    jassert(output >= 0 && output < getNumOutputs());
+
+    if (source._results.empty())
+        return;
+
+    auto registerOffset = _numRegisters;
+    auto expressionOffset = static_cast<int>(_expressions.size());
+
+    for (auto instruction : source._code)
+    {
+        instruction.target += registerOffset;
+        instruction.lhs += registerOffset;
+        instruction.rhs += registerOffset;
+
+        if (instruction.expression >= 0)
+            instruction.expression += expressionOffset;
+
+        if (precision == EXACT)
+            instruction.precision = EXACT;
+
+        _code.push_back(instruction);
+    }
+
+    _expressions.insert(_expressions.end(), source._expressions.begin(), source._expressions.end());
+    _results[output] = source._results[0] + registerOffset;
+    _numRegisters += source._numRegisters;
+}
+
+/*
+    Register storage for the evaluating thread. Every nesting level gets its own
+    buffer, so a program evaluating another expression cannot invalidate it.
+*/
+struct RegisterStack
+{
+    double* push(std::size_t size)
+    {
+        if (_depth == _levels.size())
+            _levels.emplace_back();
+
+        auto& level = _levels[_depth++];
+        if (level.size() < size)
+            level.resize(size);
+
+        return level.data();
+    }
+
+    void pop()
+    {
+        --_depth;
+    }
+
+    static RegisterStack& forThisThread()
+    {
+        static thread_local RegisterStack stack;
+        return stack;
+    }
+
+private:
+    std::vector<std::vector<double>> _levels;
+    std::size_t _depth = 0;
+};
+
+void Program::evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+{
+    if (_results.empty())
+    {
+        std::fill(ys, ys + n, std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+
+    if (_results.size() == 1)
+    {
+        evaluate(xs, &ys, n, precision);
+        return;
+    }
+
+    // Only the first output is stored, the others stay in their registers
+    std::vector<double*> outputs(_results.size(), nullptr);
+    outputs[0] = ys;
+    evaluate(xs, outputs.data(), n, precision);
+}
+
+void Program::evaluate(const double* xs, double* const* outputs, std::size_t n, Precision precision) const
+{
+    if (_results.empty())
+        return;
+
+    auto& kernels = simd::getKernels();
+    auto& stack = RegisterStack::forThisThread();
+    auto registers = stack.push(_numRegisters * BLOCK_SIZE);
+
+    for (std::size_t offset = 0; offset < n; offset += BLOCK_SIZE)
+    {
+        auto count = std::min(BLOCK_SIZE, n - offset);
+        auto x = xs + offset;
+
+        for (auto& instruction : _code)
+        {
+            auto target = registers + instruction.target * BLOCK_SIZE;
+            auto lhs = registers + instruction.lhs * BLOCK_SIZE;
+            auto rhs = registers + instruction.rhs * BLOCK_SIZE;
+            auto fast = precision == FAST && instruction.precision == FAST;
+
+            switch (instruction.op)
+            {
+                case ExpressionCompiler::LOAD_X:
+                    std::copy(x, x + count, target);
+                    break;
+
+                case ExpressionCompiler::LOAD_CONST:
+                    std::fill(target, target + count, instruction.value);
+                    break;
+
+                case ExpressionCompiler::ADD:
+                    kernels.add(lhs, rhs, target, count);
+                    break;
+
+                case ExpressionCompiler::SUB:
+                    for (std::size_t i = 0; i < count; ++i)
+                        target[i] = lhs[i] - rhs[i];
+                    break;
+
+                case ExpressionCompiler::MUL:
+                    kernels.multiply(lhs, rhs, target, count);
+                    break;
+
+                case ExpressionCompiler::DIV:
+                    for (std::size_t i = 0; i < count; ++i)
+                        target[i] = lhs[i] / rhs[i];
+                    break;
+
+                case ExpressionCompiler::NEG:
+                    for (std::size_t i = 0; i < count; ++i)
+                        target[i] = -lhs[i];
+                    break;
+
+                case ExpressionCompiler::POW:
+                    for (std::size_t i = 0; i < count; ++i)
+                        target[i] = std::pow(lhs[i], rhs[i]);
+                    break;
+
+                case ExpressionCompiler::CALL:
+                    if (fast && instruction.fastFunc)
+                    {
+                        instruction.fastFunc(lhs, target, count);
+                        break;
+                    }
+
+                    for (std::size_t i = 0; i < count; ++i)
+                        target[i] = instruction.func(lhs[i]);
+                    break;
+
+                case ExpressionCompiler::EVAL:
+                    _expressions[instruction.expression].evaluate(x, target, count, fast ? FAST : EXACT);
+                    break;
+            }
+        }
+
+        for (std::size_t i = 0; i < _results.size(); ++i)
+        {
+            if (outputs[i] == nullptr)
+                continue;
+
+            auto result = registers + _results[i] * BLOCK_SIZE;
+            std::copy(result, result + count, outputs[i] + offset);
+        }
+    }
+
+    stack.pop();
+}
+
+/************************* TESTS ***************************/
+
+#if JUCE_UNIT_TESTS
+
+class ProgramTests : public juce::UnitTest
+{
+public:
+    ProgramTests() : juce::UnitTest("aot_juceplot Program")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest("Precedence and associativity");
+
+        expectEquals(evaluate("-x^2", 3), -9.0);
+        expectEquals(evaluate("-2^2", 0), -4.0);
+        expectEquals(evaluate("2^3^2", 0), 512.0);
+        expectEquals(evaluate("1+2*3", 0), 7.0);
+        expectEquals(evaluate("(1+2)*3", 0), 9.0);
+        expectEquals(evaluate("x-1-1", 3), 1.0);
+        expectEquals(evaluate("8/2/2", 0), 2.0);
+        expectEquals(evaluate("2*-x", 3), -6.0);
+
+        beginTest("Numbers");
+
+        expectEquals(evaluate("1.", 0), 1.0);
+        expectEquals(evaluate(".5", 0), 0.5);
+        expectEquals(evaluate("1e3", 0), 1000.0);
+        expectEquals(evaluate("2.5E-1", 0), 0.25);
+
+        beginTest("Syntax errors");
+
+        for (auto text : { "1.2.3", ".", "2..", "sin(", "1 +", "(x", "foo(x)", "3 $ 4" })
+        {
+            Program program;
+            expect(Program::parse(text, program).failed(), text);
+        }
+
+        Program program;
+        expect(Program::parse("1.2.3", program).getErrorMessage().endsWith("position 3"));
+
+        beginTest("Constant folding");
+
+        for (auto text : { "2*3*4", "2^3^2", "(1+2)*3", "-2^2" })
+        {
+            expect(Program::parse(text, program).wasOk());
+            expectEquals(program.getNumInstructions(), 1, text);
+        }
+
+        expect(Program::parse("2*3+x", program).wasOk());
+        expectEquals(program.getNumInstructions(), 3);
+        expectEquals(program[1.5], 7.5);
+
+        beginTest("Shared subexpressions");
+
+        // x, sin and the sum
+        expect(Program::parse("sin(x)+sin(x)", program).wasOk());
+        expectEquals(program.getNumInstructions(), 3);
+        expectWithinAbsoluteError(program[0.5], 2 * std::sin(0.5), 1e-15);
+
+        // x, 2, the product, sin, 0.5, the scaled sin and the sum
+        auto tree = Program::compile(sin(x * 2.0) + sin(x * 2.0) * 0.5);
+        expectEquals(tree.getNumInstructions(), 7);
+        expectWithinAbsoluteError(tree[0.5], 1.5 * std::sin(1.0), 1e-15);
+
+        beginTest("Register allocation");
+
+        // Every product needs its two sums, and one product is held while the other is computed
+        expect(Program::parse("((x+1)*(x+2))*((x+3)*(x+4))", program).wasOk());
+        expectLessOrEqual(program.getNumRegisters(), 4);
+        expectEquals(program[3], 840.0);
+
+        // A chain reuses the same registers however long it is
+        expect(Program::parse("sin(cos(sin(cos(sin(x+1)+2)+3)+4)+5)", program).wasOk());
+        expectLessOrEqual(program.getNumRegisters(), 2);
+
+        std::vector<double> xs(3 * BLOCK_SIZE + 5), ys(xs.size());
+        for (std::size_t i = 0; i < xs.size(); ++i)
+            xs[i] = i * 0.01;
+
+        program.evaluate(xs.data(), ys.data(), xs.size(), EXACT);
+
+        auto worst = 0.0;
+        for (std::size_t i = 0; i < xs.size(); ++i)
+            worst = std::max(worst, std::abs(ys[i] - std::sin(std::cos(std::sin(std::cos(std::sin(xs[i] + 1) + 2) + 3) + 4) + 5)));
+
+        expectLessThan(worst, 1e-15);
+
+        beginTest("Replacing outputs");
+
+        std::vector<PlotData> curves { { x * 2.0, "a", juce::Colours::red }, { x * 3.0, "b", juce::Colours::red } };
+        auto both = Program::compile(curves);
+
+        Program replacement;
+        Program::TreeBuilder builder(replacement);
+        builder.finish(builder.add(builder.x(), builder.constant(1)));
+
+        both.setOutput(1, replacement, EXACT);
+
+        double at = 3, first, second;
+        double* outputs[] = { &first, &second };
+        both.evaluate(&at, outputs, 1, EXACT);
+
+        expectEquals(first, 6.0);
+        expectEquals(second, 4.0);
+    }
+
+private:
+    double evaluate(const char* text, double x)
+    {
+        Program program;
+        auto result = Program::parse(text, program);
+        expect(result.wasOk(), juce::String(text) + ": " + result.getErrorMessage());
+        return program[x];
+    }
+};
+
+static ProgramTests programTests;
+
+#endif
@@ -0,0 +1,202 @@
+#pragma once
+
+/*
+    A formula compiled to a flat list of register instructions, e.g. from the
+    text "sin(2*x) + 0.5*x*x". Registers hold one block of samples each and are
+    reused as soon as their value is no longer needed, so a program evaluates
+    with a small, cache resident working set and without chasing node pointers.
+
+    Supported syntax: numbers, x, pi, e, + - * / ^, unary minus, parentheses
+    and the functions sin, cos, tan, exp, log, sqrt and abs.
+
+    Expression trees can be compiled too. Constants are folded and equal subtrees
+    become one value, so a node shared by several branches or by several curves
+    is evaluated once per block. Nodes the compiler does not know (samples,
+    expression templates, ...) are kept as opaque instructions.
+
+    A Program can be handed to PlotStream::addPlotData like any other expression,
+    and to PlotStream::setPlotData to replace a curve without compiling again.
+*/
+class Program
+{
+public:
+    Program() = default;
+
+    /* Compiles text into program. On failure program is left untouched */
+    static juce::Result parse(const juce::String& text, Program& program);
+
+    /* Compiles a tree, the precision is picked when evaluating */
+    static Program compile(const Expression& expression);
+
+    /* Compiles all curves into one program with one output each, using their own precision */
+    static Program compile(const std::vector<PlotData>& plotData);
+
+    double operator[](double i) const
+    {
+        double result;
+        evaluate(&i, &result, 1, EXACT);
+        return result;
+    }
+
+    class TreeBuilder;
+
+    /* Evaluates the first output */
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const;
+
+    /* Evaluates all outputs, outputs[i] receives n values of output i */
+    void evaluate(const double* xs, double* const* outputs, std::size_t n, Precision precision) const;
+
+    /* Inlines the first output into another compilation */
+    int compile(ExpressionCompiler& compiler) const;
+
+    /*
+        Makes output the first output of source. Its instructions are appended as
+        they are, in registers of their own, so nothing is compiled again and once
+        this program has grown to the size nothing is allocated either. What output
+        was computed from before is still evaluated. With EXACT, the functions of
+        source are evaluated exactly too.
+    */
+    void setOutput(int output, const Program& source, Precision precision);
+
+    int getNumInstructions() const { return static_cast<int>(_code.size()); }
+    int getNumRegisters() const { return _numRegisters; }
+    int getNumOutputs() const { return static_cast<int>(_results.size()); }
+
+private:
+    typedef ExpressionCompiler::OpCode OpCode;
+
+    struct Instruction
+    {
+        OpCode op;
+        int target;
+        int lhs;
+        int rhs;
+        double value;
+        Func func;
+        simd::UnaryKernel fastFunc;
+        Precision precision;    // CALL and EVAL may only go FAST if this is FAST
+        int expression;         // EVAL: index into _expressions
+    };
+
+    class Builder;
+    class Parser;
+
+    std::vector<Instruction> _code;
+    std::vector<Expression> _expressions;
+    std::vector<int> _results;
+    int _numRegisters = 0;
+};
+
+/*
+    Writes a tree straight into a program, without the folding and sharing of
+    Program::compile. Every node is one instruction appended to the program and
+    registers are assigned as nodes are added, so the tree lives in one block
+    and rebuilding the same Program, e.g. on every slider movement, allocates
+    nothing once its storage has grown to the size of the tree. PlotStream::setPlotData
+    draws it without compiling it again.
+
+    Children have to be added before their parents and every value can be used
+    as an operand only once.
+
+        Program program;
+        Program::TreeBuilder tree(program);
+        tree.finish(tree.sin(tree.multiply(tree.x(), tree.constant(gain))));
+*/
+class Program::TreeBuilder
+{
+public:
+    /* Discards what program held before, keeping its storage */
+    explicit TreeBuilder(Program& program) : _program(program)
+    {
+        _program._code.clear();
+        _program._expressions.clear();
+        _program._results.clear();
+        _program._numRegisters = 0;
+    }
+
+    int x()                                 { return emit(ExpressionCompiler::LOAD_X, -1, -1); }
+    int add(int lhs, int rhs)               { return emit(ExpressionCompiler::ADD, lhs, rhs); }
+    int subtract(int lhs, int rhs)          { return emit(ExpressionCompiler::SUB, lhs, rhs); }
+    int multiply(int lhs, int rhs)          { return emit(ExpressionCompiler::MUL, lhs, rhs); }
+    int divide(int lhs, int rhs)            { return emit(ExpressionCompiler::DIV, lhs, rhs); }
+    int power(int lhs, int rhs)             { return emit(ExpressionCompiler::POW, lhs, rhs); }
+    int negate(int operand)                 { return emit(ExpressionCompiler::NEG, operand, -1); }
+
+    int sin(int operand)                    { return call(std::sin, simd::getKernels().sin, operand); }
+    int cos(int operand)                    { return call(std::cos, simd::getKernels().cos, operand); }
+    int exp(int operand)                    { return call(std::exp, simd::getKernels().exp, operand); }
+    int log(int operand)                    { return call(std::log, simd::getKernels().log, operand); }
+
+    int constant(double value)
+    {
+        auto index = emit(ExpressionCompiler::LOAD_CONST, -1, -1);
+        _program._code[index].value = value;
+        return index;
+    }
+
+    int call(Func func, simd::UnaryKernel fastFunc, int operand)
+    {
+        auto index = emit(ExpressionCompiler::CALL, operand, -1);
+        _program._code[index].func = func;
+        _program._code[index].fastFunc = fastFunc;
+        return index;
+    }
+
+    /* Makes root the output of the program */
+    void finish(int root)
+    {
+        _program._results.push_back(_program._code[root].target);
+        _program._numRegisters = _numRegisters;
+    }
+
+private:
+    int emit(OpCode op, int lhs, int rhs)
+    {
+        auto& code = _program._code;
+
+        // Operands give their register back first, operations work element-wise
+        auto lhsRegister = lhs >= 0 ? release(lhs) : 0;
+        auto rhsRegister = rhs >= 0 && rhs != lhs ? release(rhs) : lhsRegister;
+
+        code.push_back({ op, acquire(), lhsRegister, rhsRegister, 0, nullptr, nullptr, FAST, -1 });
+        return static_cast<int>(code.size()) - 1;
+    }
+
+    int acquire()
+    {
+        return _numFree > 0 ? _freeRegisters[--_numFree] : _numRegisters++;
+    }
+
+    int release(int value)
+    {
+        jassert(value < static_cast<int>(_program._code.size()));
+
+       #if JUCE_DEBUG
+        // A value read twice would be overwritten in between
+        if (_used.size() <= static_cast<std::size_t>(value))
+            _used.resize(value + 1, false);
+
+        jassert(! _used[value]);
+        _used[value] = true;
+       #endif
+
+        auto reg = _program._code[value].target;
+
+        // Beyond this many free registers new ones are taken instead
+        if (_numFree < MAX_FREE_REGISTERS)
+            _freeRegisters[_numFree++] = reg;
+
+        return reg;
+    }
+
+    static const int MAX_FREE_REGISTERS = 32;
+
+    Program& _program;
+    int _numRegisters = 0;
+    int _freeRegisters[MAX_FREE_REGISTERS];
+    int _numFree = 0;
+
+   #if JUCE_DEBUG
+    std::vector<bool> _used;
+   #endif
+};
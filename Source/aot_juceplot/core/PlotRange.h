@@ -31,16 +31,26 @@ struct PlotRange
         return (hiX - loX) / grain;
     }
     
-    double getXRange()
+    double getXRange() const
     {
         return hiX - loX;
     }
     
-    double getYRange()
+    double getYRange() const
     {
         return hiY - loY;
     }
     
+    bool operator== (const PlotRange& other) const
+    {
+        return loX == other.loX && hiX == other.hiX && loY == other.loY && hiY == other.hiY;
+    }
+    
+    bool operator!= (const PlotRange& other) const
+    {
+        return ! (*this == other);
+    }
+    
     template <typename StreamT>
     friend StreamT& operator<< (StreamT& stream, const PlotRange& plotRange)
     {
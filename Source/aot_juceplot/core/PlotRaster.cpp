@@ -0,0 +1,116 @@
+void LineRaster::setColour(juce::Colour colour)
+{
+    _colour = colour.getPixelARGB();
+}
+
+void LineRaster::drawPolyline(const juce::Point<float>* points, std::size_t numPoints)
+{
+    for (std::size_t i = 1; i < numPoints; ++i)
+        drawLine(points[i - 1].getX(), points[i - 1].getY(), points[i].getX(), points[i].getY());
+}
+
+void LineRaster::drawLine(float x0, float y0, float x1, float y1)
+{
+    if (! clip(x0, y0, x1, y1))
+        return;
+
+    // Step along the major axis
+    auto steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+    if (steep)
+    {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+
+    if (x0 > x1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    auto gradient = x1 > x0 ? (y1 - y0) / (x1 - x0) : 0.0f;
+
+    // Pixels whose centre lies in [x0, x1), so joined segments share no pixel
+    auto first = static_cast<int>(std::ceil(x0 - 0.5f));
+    auto last = static_cast<int>(std::ceil(x1 - 0.5f));
+
+    for (auto major = first; major < last; ++major)
+    {
+        auto minor = y0 + gradient * (major + 0.5f - x0) - 0.5f;
+
+        if (! _antialiased)
+        {
+            auto nearest = static_cast<int>(std::floor(minor + 0.5f));
+            if (steep)
+                blend(nearest, major, 1.0f);
+            else
+                blend(major, nearest, 1.0f);
+
+            continue;
+        }
+
+        auto lower = std::floor(minor);
+        auto fraction = minor - lower;
+        auto row = static_cast<int>(lower);
+
+        if (steep)
+        {
+            blend(row, major, 1.0f - fraction);
+            blend(row + 1, major, fraction);
+        }
+        else
+        {
+            blend(major, row, 1.0f - fraction);
+            blend(major, row + 1, fraction);
+        }
+    }
+}
+
+/* Liang-Barsky against the bitmap, widened by a pixel for the antialiasing */
+bool LineRaster::clip(float& x0, float& y0, float& x1, float& y1) const
+{
+    if (! (std::isfinite(x0) && std::isfinite(y0) && std::isfinite(x1) && std::isfinite(y1)))
+        return false;
+
+    auto dx = x1 - x0;
+    auto dy = y1 - y0;
+    float t0 = 0, t1 = 1;
+
+    const float p[] = { -dx, dx, -dy, dy };
+    const float q[] = { x0 + 1, _data.width + 1 - x0, y0 + 1, _data.height + 1 - y0 };
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (p[i] == 0)
+        {
+            if (q[i] < 0)
+                return false;
+
+            continue;
+        }
+
+        auto t = q[i] / p[i];
+        if (p[i] < 0)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+
+        if (t0 > t1)
+            return false;
+    }
+
+    x1 = x0 + t1 * dx;
+    y1 = y0 + t1 * dy;
+    x0 += t0 * dx;
+    y0 += t0 * dy;
+    return true;
+}
+
+void LineRaster::blend(int x, int y, float coverage)
+{
+    if (x < 0 || y < 0 || x >= _data.width || y >= _data.height)
+        return;
+
+    auto pixel = reinterpret_cast<juce::PixelARGB*>(_data.getPixelPointer(x, y));
+    pixel->blend(_colour, static_cast<juce::uint32>(coverage * 256.0f + 0.5f));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+    Draws antialiased, 1 pixel wide polylines straight into ARGB bitmap data,
+    using Xiaolin Wu's algorithm. Every segment costs a couple of pixel blends
+    per column and no rasteriser setup, which pays off with many curves of many
+    points. Segments are clipped to the bitmap first, so coordinates far outside
+    it (e.g. tan(x) near its poles) cost nothing.
+*/
+class LineRaster
+{
+public:
+    explicit LineRaster(const juce::Image::BitmapData& data) : _data(data) { }
+
+    void setColour(juce::Colour colour);
+
+    /* Without antialiasing every column gets the one nearest pixel */
+    void setAntialiased(bool antialiased) { _antialiased = antialiased; }
+
+    /* Points with a NaN coordinate break the line */
+    void drawPolyline(const juce::Point<float>* points, std::size_t numPoints);
+
+    void drawLine(float x0, float y0, float x1, float y1);
+
+private:
+    bool clip(float& x0, float& y0, float& x1, float& y1) const;
+    void blend(int x, int y, float coverage);
+
+    const juce::Image::BitmapData& _data;
+    juce::PixelARGB _colour;
+    bool _antialiased = true;
+};
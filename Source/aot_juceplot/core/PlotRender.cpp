@@ -0,0 +1,46 @@
+/* The typefaces labels are drawn with, looked up at once by many threads they would race in the typeface cache */
+static bool createTypefaces()
+{
+    juce::Font().getTypeface();
+    
+    juce::Font font;
+    font.setTypefaceName(juce::Font::getDefaultSansSerifFontName());
+    font.getTypeface();
+    
+    return true;
+}
+
+juce::Image renderPlot(const std::vector<PlotData>& curves, PlotRange range, int width, int height,
+                       float scale, juce::Colour background)
+{
+    jassert(width > 0 && height > 0 && scale > 0);
+    
+    // Once for all threads, the others wait for the first
+    static auto typefacesCreated = createTypefaces();
+    juce::ignoreUnused(typefacesCreated);
+    
+    // Software images never touch a display
+    juce::Image image(juce::Image::ARGB, juce::roundToInt(width * scale), juce::roundToInt(height * scale),
+                      true, juce::SoftwareImageType());
+    
+    juce::Graphics graphics(image);
+    graphics.addTransform(juce::AffineTransform::scale(scale));
+    graphics.fillAll(background);
+    
+    PlotStream stream;
+    stream.setWindow(width, height);
+    stream.setPlotRange(range);
+    
+    for (auto& curve : curves)
+        stream.addPlotData(curve.expr, curve.colour, curve.name, curve.precision);
+    
+    stream.plot(graphics);
+    return image;
+}
+
+bool renderPlotAsPng(juce::OutputStream& stream, const std::vector<PlotData>& curves, PlotRange range,
+                     int width, int height, float scale, juce::Colour background)
+{
+    juce::PNGImageFormat png;
+    return png.writeImageToStream(renderPlot(curves, range, width, height, scale, background), stream);
+}
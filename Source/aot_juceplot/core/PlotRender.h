@@ -0,0 +1,18 @@
+#pragma once
+
+/*
+    Off-screen rendering, for plots nobody looks at on screen, e.g. reports
+    generated in batch jobs. No component is needed, but JUCE must have been
+    initialised for the fonts of the labels, e.g. by a ScopedJuceInitialiser_GUI
+    in main(). Every call draws with a PlotStream of its own into an image of
+    its own, and the first one creates the typefaces all of them share, so
+    any number of them can then run on different threads at once.
+*/
+
+/* Draws curves over range into a new width x height image, scale times as many pixels */
+juce::Image renderPlot(const std::vector<PlotData>& curves, PlotRange range, int width, int height,
+                       float scale = 1.0f, juce::Colour background = juce::Colours::white);
+
+/* Same, written to stream as PNG. Returns false if writing failed */
+bool renderPlotAsPng(juce::OutputStream& stream, const std::vector<PlotData>& curves, PlotRange range,
+                     int width, int height, float scale = 1.0f, juce::Colour background = juce::Colours::white);
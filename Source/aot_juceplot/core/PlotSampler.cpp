@@ -0,0 +1,268 @@
+// Adaptive sampling constants, in pixels
+static const double INITIAL_SPACING = 16;
+static const double MIN_SPACING = 0.25;
+static const double TOLERANCE = 0.5;
+
+// Positions evaluated by one task, fewer are not worth handing to another thread
+static const std::size_t CHUNK_SIZE = 16 * BLOCK_SIZE;
+
+void PlotSampler::sampleUniform(const Program& program, double loX, double hiX, std::size_t numPoints, Precision precision)
+{
+    numPoints = std::max<std::size_t>(2, numPoints);
+    auto incr = (hiX - loX) / (numPoints - 1);
+
+    _xs.resize(numPoints);
+    for (std::size_t i = 0; i < numPoints; ++i)
+        _xs[i] = loX + i * incr;
+
+    evaluate(program, _xs, _ys, precision);
+    _numEvaluated = numPoints;
+}
+
+void PlotSampler::sampleAdaptive(const Program& program, double loX, double hiX, double xScale, double yScale, Precision precision)
+{
+    auto numIntervals = static_cast<std::size_t>(std::max(1.0, std::ceil((hiX - loX) * xScale / INITIAL_SPACING)));
+    auto intervalWidth = (hiX - loX) / numIntervals;
+    auto minWidth = MIN_SPACING / xScale;
+
+    _xs.resize(numIntervals + 1);
+    for (std::size_t i = 0; i <= numIntervals; ++i)
+        _xs[i] = loX + i * intervalWidth;
+
+    evaluate(program, _xs, _ys, precision);
+    _numEvaluated = _xs.size();
+
+    _open.assign(numIntervals, true);
+    refine(program, numIntervals, minWidth, yScale, precision);
+}
+
+void PlotSampler::refineAdaptive(const Program& program, double loX, double hiX, double xScale, double yScale, Precision precision)
+{
+    trim(loX, hiX);
+
+    if (_xs.size() < 2 || _xs.front() > loX || _xs.back() < hiX || _ys.size() != static_cast<std::size_t>(program.getNumOutputs()))
+    {
+        sampleAdaptive(program, loX, hiX, xScale, yScale, precision);
+        return;
+    }
+
+    auto maxWidth = INITIAL_SPACING / xScale;
+    auto minWidth = MIN_SPACING / xScale;
+    auto numIntervals = _xs.size() - 1;
+    std::size_t numOpen = 0;
+
+    _numEvaluated = 0;
+    _open.resize(numIntervals);
+
+    for (std::size_t i = 0; i < numIntervals; ++i)
+    {
+        auto width = _xs[i + 1] - _xs[i];
+        _open[i] = width > minWidth && (width > maxWidth || bends(i, yScale));
+        numOpen += _open[i] ? 1 : 0;
+    }
+
+    refine(program, numOpen, minWidth, yScale, precision);
+}
+
+void PlotSampler::refine(const Program& program, std::size_t numOpen, double minWidth, double yScale, Precision precision)
+{
+    while (numOpen > 0)
+    {
+        // Two inner points per interval: unlike a midpoint, they also see
+        // the bend around an inflection point
+        _innerXs.clear();
+        for (std::size_t i = 0; i + 1 < _xs.size(); ++i)
+        {
+            if (! _open[i])
+                continue;
+
+            auto third = (_xs[i + 1] - _xs[i]) / 3;
+            _innerXs.push_back(_xs[i] + third);
+            _innerXs.push_back(_xs[i + 1] - third);
+        }
+
+        evaluate(program, _innerXs, _innerYs, precision);
+        _numEvaluated += _innerXs.size();
+
+        // Merge the inner points in, deciding which thirds to refine further
+        _nextXs.clear();
+        _nextOpen.clear();
+        _nextYs.resize(_ys.size());
+        for (auto& ys : _nextYs)
+            ys.clear();
+
+        numOpen = 0;
+        std::size_t inner = 0;
+
+        for (std::size_t i = 0; i < _xs.size(); ++i)
+        {
+            _nextXs.push_back(_xs[i]);
+            for (std::size_t output = 0; output < _ys.size(); ++output)
+                _nextYs[output].push_back(_ys[output][i]);
+
+            if (i + 1 == _xs.size())
+                break;
+
+            if (! _open[i])
+            {
+                _nextOpen.push_back(false);
+                continue;
+            }
+
+            auto canSplit = (_xs[i + 1] - _xs[i]) / 3 > minWidth;
+            auto split = canSplit && needsSplit(i, inner, yScale);
+            numOpen += split ? 3 : 0;
+
+            for (auto k = inner; k < inner + 2; ++k)
+            {
+                _nextXs.push_back(_innerXs[k]);
+                for (std::size_t output = 0; output < _ys.size(); ++output)
+                    _nextYs[output].push_back(_innerYs[output][k]);
+            }
+
+            _nextOpen.insert(_nextOpen.end(), 3, split);
+            inner += 2;
+        }
+
+        std::swap(_xs, _nextXs);
+        std::swap(_ys, _nextYs);
+        std::swap(_open, _nextOpen);
+    }
+}
+
+void PlotSampler::merge(const PlotSampler& strip)
+{
+    if (strip._xs.empty())
+        return;
+
+    auto& xs = strip._xs;
+    auto appends = ! _xs.empty() && xs.front() >= _xs.back() && _ys.size() == strip._ys.size();
+    auto prepends = ! _xs.empty() && xs.back() <= _xs.front() && _ys.size() == strip._ys.size();
+
+    if (! appends && ! prepends)
+    {
+        _xs = strip._xs;
+        _ys = strip._ys;
+        _numEvaluated = strip._numEvaluated;
+        return;
+    }
+
+    // Positions both have are taken from this one
+    auto begin = appends ? std::upper_bound(xs.begin(), xs.end(), _xs.back()) : xs.begin();
+    auto end = prepends ? std::lower_bound(xs.begin(), xs.end(), _xs.front()) : xs.end();
+    auto from = static_cast<std::size_t>(begin - xs.begin());
+    auto to = static_cast<std::size_t>(end - xs.begin());
+
+    _xs.insert(appends ? _xs.end() : _xs.begin(), begin, end);
+
+    for (std::size_t output = 0; output < _ys.size(); ++output)
+    {
+        auto& source = strip._ys[output];
+        _ys[output].insert(appends ? _ys[output].end() : _ys[output].begin(), source.begin() + from, source.begin() + to);
+    }
+
+    _numEvaluated = strip._numEvaluated;
+}
+
+void PlotSampler::trim(double loX, double hiX)
+{
+    auto begin = std::lower_bound(_xs.begin(), _xs.end(), loX);
+    auto end = std::upper_bound(_xs.begin(), _xs.end(), hiX);
+
+    // One position beyond each border carries the line up to it
+    auto from = static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, begin - _xs.begin() - 1));
+    auto to = std::min(_xs.size(), static_cast<std::size_t>(end - _xs.begin()) + 1);
+
+    _xs.erase(_xs.begin() + to, _xs.end());
+    _xs.erase(_xs.begin(), _xs.begin() + from);
+
+    for (auto& ys : _ys)
+    {
+        ys.erase(ys.begin() + to, ys.end());
+        ys.erase(ys.begin(), ys.begin() + from);
+    }
+}
+
+void PlotSampler::evaluate(const Program& program, const std::vector<double>& xs,
+                           std::vector<std::vector<double>>& ys, Precision precision)
+{
+    auto numOutputs = static_cast<std::size_t>(program.getNumOutputs());
+    auto numChunks = (xs.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    ys.resize(numOutputs);
+    for (auto& output : ys)
+        output.resize(xs.size());
+
+    // The outputs of each chunk, chunks are evaluated in parallel
+    _outputs.resize(numOutputs * numChunks);
+
+    for (std::size_t chunk = 0; chunk < numChunks; ++chunk)
+        for (std::size_t output = 0; output < numOutputs; ++output)
+            _outputs[chunk * numOutputs + output] = ys[output].data() + chunk * CHUNK_SIZE;
+
+    parallel::forEach(numChunks, [&](std::size_t chunk)
+    {
+        auto offset = chunk * CHUNK_SIZE;
+        program.evaluate(xs.data() + offset, _outputs.data() + chunk * numOutputs,
+                         std::min(CHUNK_SIZE, xs.size() - offset), precision);
+    });
+}
+
+bool PlotSampler::needsSplit(std::size_t interval, std::size_t inner, double yScale) const
+{
+    for (std::size_t output = 0; output < _ys.size(); ++output)
+    {
+        if (isIgnored(output))
+            continue;
+
+        auto lhs = _ys[output][interval];
+        auto rhs = _ys[output][interval + 1];
+        auto finite = std::isfinite(lhs);
+
+        for (std::size_t k = 0; k < 2; ++k)
+        {
+            auto y = _innerYs[output][inner + k];
+            auto chord = lhs + (rhs - lhs) * (k + 1) / 3;
+
+            // Edges of the domain, e.g. log(x) near 0, are narrowed down
+            if (std::isfinite(y) != finite || finite != std::isfinite(rhs))
+                return true;
+
+            if (finite && std::abs(y - chord) * yScale > TOLERANCE)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool PlotSampler::bends(std::size_t interval, double yScale) const
+{
+    for (std::size_t output = 0; output < _ys.size(); ++output)
+    {
+        if (isIgnored(output))
+            continue;
+
+        auto& ys = _ys[output];
+
+        // Either end off the chord through its neighbours
+        for (auto point = std::max<std::size_t>(interval, 1); point <= interval + 1 && point + 1 < _xs.size(); ++point)
+        {
+            auto lhs = ys[point - 1];
+            auto rhs = ys[point + 1];
+            auto y = ys[point];
+
+            if (std::isfinite(y) != std::isfinite(lhs) || std::isfinite(y) != std::isfinite(rhs))
+                return true;
+
+            if (! std::isfinite(y))
+                continue;
+
+            auto t = (_xs[point] - _xs[point - 1]) / (_xs[point + 1] - _xs[point - 1]);
+            if (std::abs(y - (lhs + (rhs - lhs) * t)) * yScale > TOLERANCE)
+                return true;
+        }
+    }
+
+    return false;
+}
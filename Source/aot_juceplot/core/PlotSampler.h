@@ -0,0 +1,91 @@
+#pragma once
+
+/** How the x positions of curves are chosen */
+enum Sampling
+{
+    UNIFORM,    // Grain::MEDIUM steps, whatever the size of the plot
+    ADAPTIVE    // dense where the curves bend, sparse where they are straight
+};
+
+/*
+    Chooses the positions at which the outputs of a program are evaluated.
+
+    Adaptive sampling starts with a sample every 16 pixels and evaluates every
+    interval at a third and two thirds of its width. An interval where one of
+    these is off the chord by more than half a pixel, in any of the curves, is
+    split in thirds and those are tested the same way, down to a fraction of a
+    pixel. All points of a level are evaluated in one batch, so the program
+    still runs over whole blocks. Large batches are split into chunks that are
+    evaluated in parallel.
+*/
+class PlotSampler
+{
+public:
+    /* numPoints positions evenly spread over [loX, hiX] */
+    void sampleUniform(const Program& program, double loX, double hiX, std::size_t numPoints, Precision precision);
+
+    /* xScale and yScale are the number of pixels per unit */
+    void sampleAdaptive(const Program& program, double loX, double hiX, double xScale, double yScale, Precision precision);
+
+    /*
+        Adaptive sampling that starts from the positions held, of a range around
+        [loX, hiX], instead of a coarse grid: an interval is only refined where it
+        is too wide for the new scales, or where its ends are off the chords
+        through their neighbours. After zooming in, what was evaluated for the
+        wider view is kept and only the bends need new positions. Falls back to
+        sampleAdaptive() when the positions held do not cover the range.
+    */
+    void refineAdaptive(const Program& program, double loX, double hiX, double xScale, double yScale, Precision precision);
+
+    /*
+        Outputs adaptive sampling does not look at, e.g. dense series drawn per
+        pixel column from their envelope: they are evaluated at the positions the
+        other outputs need, but never make an interval split. None by default.
+    */
+    void setIgnoredOutputs(const std::vector<bool>& ignored) { _ignored = ignored; }
+
+    /*
+        Adds the positions of strip, which lies left or right of ours and shares
+        the position at the border. Anything else replaces ours.
+    */
+    void merge(const PlotSampler& strip);
+
+    /* Drops positions outside [loX, hiX], except the ones the lines to the border need */
+    void trim(double loX, double hiX);
+
+    std::size_t size() const { return _xs.size(); }
+
+    const std::vector<double>& getXs() const { return _xs; }
+    const std::vector<double>& getYs(int output) const { return _ys[output]; }
+
+    /* Number of positions evaluated by the last call, including the rejected ones */
+    std::size_t getNumEvaluated() const { return _numEvaluated; }
+
+private:
+    void evaluate(const Program& program, const std::vector<double>& xs,
+                  std::vector<std::vector<double>>& ys, Precision precision);
+
+    /* Splits the open intervals until none is off the chord or they are too narrow */
+    void refine(const Program& program, std::size_t numOpen, double minWidth, double yScale, Precision precision);
+
+    bool needsSplit(std::size_t interval, std::size_t inner, double yScale) const;
+
+    bool bends(std::size_t interval, double yScale) const;
+
+    bool isIgnored(std::size_t output) const { return output < _ignored.size() && _ignored[output]; }
+
+    std::vector<double> _xs;
+    std::vector<std::vector<double>> _ys;
+    std::vector<bool> _open;
+    std::vector<bool> _ignored;
+
+    // Scratch for one level of refinement, kept to avoid allocations
+    std::vector<double> _innerXs;
+    std::vector<std::vector<double>> _innerYs;
+    std::vector<double> _nextXs;
+    std::vector<std::vector<double>> _nextYs;
+    std::vector<bool> _nextOpen;
+    std::vector<double*> _outputs;
+
+    std::size_t _numEvaluated = 0;
+};
@@ -0,0 +1,377 @@
+// Series files, see MappedSamples
+static const char SERIES_MAGIC[8] = { 'A', 'O', 'T', 'P', 'L', 'O', 'T', '1' };
+static const char LOD_MAGIC[8] = { 'A', 'O', 'T', 'L', 'O', 'D', '1', 0 };
+static const std::size_t SERIES_HEADER_SIZE = 8 + 2 * sizeof(std::uint64_t);
+static const std::size_t LOD_HEADER_SIZE = 8 + 3 * sizeof(std::uint64_t);
+static const std::size_t LOD_LEAF_SIZE = 64;
+
+/* Sizes of the levels of a pyramid over numSamples, the top one has a single entry */
+static std::vector<std::size_t> getLodLevelSizes(std::size_t numSamples)
+{
+    std::vector<std::size_t> sizes;
+    
+    for (auto size = (numSamples + LOD_LEAF_SIZE - 1) / LOD_LEAF_SIZE; size > 0; size = size > 1 ? (size + 1) / 2 : 0)
+        sizes.push_back(size);
+    
+    return sizes;
+}
+
+static std::uint64_t readUInt64(const char* data)
+{
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/* a * b, false if it does not fit into 64 bits */
+static bool multiplyChecked(std::uint64_t a, std::uint64_t b, std::uint64_t& product)
+{
+    if (a != 0 && b > std::numeric_limits<std::uint64_t>::max() / a)
+        return false;
+    
+    product = a * b;
+    return true;
+}
+
+static juce::File getLodFile(const juce::File& file)
+{
+    return file.withFileExtension(file.getFileExtension() + ".lod");
+}
+
+MappedSamples::MappedSamples(const juce::File& file, int channel)
+{
+#if ! JUCE_BIG_ENDIAN
+    _file = std::make_shared<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    
+    auto data = static_cast<const char*>(_file->getData());
+    auto size = _file->getSize();
+    
+    if (data == nullptr || size < SERIES_HEADER_SIZE || std::memcmp(data, SERIES_MAGIC, 8) != 0)
+        return;
+    
+    auto numSamples = readUInt64(data + 8);
+    auto numChannels = readUInt64(data + 16);
+    auto numValues = static_cast<std::uint64_t>((size - SERIES_HEADER_SIZE) / sizeof(double));
+    
+    // The header is not trusted: x and every channel need room for their values
+    if (channel < 0 || static_cast<std::uint64_t>(channel) >= numChannels || numChannels >= numValues
+        || numValues / (numChannels + 1) < numSamples)
+        return;
+    
+    _size = static_cast<std::size_t>(numSamples);
+    _xs = reinterpret_cast<const double*>(data + SERIES_HEADER_SIZE);
+    _ys = _xs + (channel + 1) * _size;
+    
+    // The pyramid is optional, one that does not match is ignored
+    auto lodFile = getLodFile(file);
+    if (! lodFile.exists())
+        return;
+    
+    _lod = std::make_shared<juce::MemoryMappedFile>(lodFile, juce::MemoryMappedFile::readOnly);
+    
+    auto lod = static_cast<const char*>(_lod->getData());
+    auto levelSizes = getLodLevelSizes(_size);
+    
+    std::size_t numEntries = 0;
+    for (auto levelSize : levelSizes)
+        numEntries += levelSize;
+    
+    std::uint64_t channelBytes, lodBytes;
+    
+    if (lod == nullptr || _lod->getSize() < LOD_HEADER_SIZE
+        || ! multiplyChecked(numEntries, 2 * sizeof(double), channelBytes)
+        || ! multiplyChecked(numChannels, channelBytes, lodBytes)
+        || _lod->getSize() - LOD_HEADER_SIZE < lodBytes
+        || std::memcmp(lod, LOD_MAGIC, 8) != 0 || readUInt64(lod + 8) != numSamples
+        || readUInt64(lod + 16) != numChannels || readUInt64(lod + 24) != LOD_LEAF_SIZE)
+    {
+        _lod = nullptr;
+        return;
+    }
+    
+    auto entry = reinterpret_cast<const double*>(lod + LOD_HEADER_SIZE) + channel * numEntries * 2;
+    
+    for (auto levelSize : levelSizes)
+    {
+        _levels.push_back(entry);
+        entry += levelSize * 2;
+    }
+#else
+    juce::ignoreUnused(file, channel);
+#endif
+}
+
+void MappedSamples::findRange(std::size_t begin, std::size_t end, double& min, double& max) const
+{
+    min = std::numeric_limits<double>::infinity();
+    max = -min;
+    
+    auto add = [&min, &max](double lo, double hi)
+    {
+        min = lo < min ? lo : min;
+        max = hi > max ? hi : max;
+    };
+    
+    if (! _levels.empty())
+    {
+        while (begin < end && begin % LOD_LEAF_SIZE != 0)
+        {
+            add(_ys[begin], _ys[begin]);
+            ++begin;
+        }
+        
+        std::size_t level = 0;
+        auto blockSize = LOD_LEAF_SIZE;
+        
+        while (begin + blockSize <= end)
+        {
+            // Largest aligned block that fits
+            while (level + 1 < _levels.size() && begin % (blockSize * 2) == 0 && begin + blockSize * 2 <= end)
+            {
+                ++level;
+                blockSize *= 2;
+            }
+            
+            auto entry = _levels[level] + 2 * (begin / blockSize);
+            add(entry[0], entry[1]);
+            begin += blockSize;
+            
+            while (level > 0 && begin + blockSize > end)
+            {
+                --level;
+                blockSize /= 2;
+            }
+        }
+    }
+    
+    for (; begin < end; ++begin)
+        add(_ys[begin], _ys[begin]);
+}
+
+juce::Result MappedSamples::write(const juce::File& file, const double* xs, const double* const* ys, int numChannels, std::size_t n)
+{
+    file.deleteFile();
+    juce::FileOutputStream stream(file);
+    
+    if (stream.failedToOpen())
+        return stream.getStatus();
+    
+    auto bytes = n * sizeof(double);
+    auto ok = stream.write(SERIES_MAGIC, 8)
+        && stream.writeInt64(static_cast<juce::int64>(n))
+        && stream.writeInt64(numChannels)
+        && stream.write(xs, bytes);
+    
+    for (auto channel = 0; channel < numChannels && ok; ++channel)
+        ok = stream.write(ys[channel], bytes);
+    
+    stream.flush();
+    return ok ? stream.getStatus() : juce::Result::fail("Could not write " + file.getFullPathName());
+}
+
+juce::Result MappedSamples::writeLod(const juce::File& file)
+{
+    MappedSamples samples(file);
+    if (! samples.isValid())
+        return juce::Result::fail(file.getFullPathName() + " is not a series file");
+    
+    auto data = static_cast<const char*>(samples._file->getData());
+    auto numChannels = readUInt64(data + 16);
+    auto numSamples = samples._size;
+    auto levelSizes = getLodLevelSizes(numSamples);
+    
+    auto lodFile = getLodFile(file);
+    lodFile.deleteFile();
+    juce::FileOutputStream stream(lodFile);
+    
+    if (stream.failedToOpen())
+        return stream.getStatus();
+    
+    auto ok = stream.write(LOD_MAGIC, 8)
+        && stream.writeInt64(static_cast<juce::int64>(numSamples))
+        && stream.writeInt64(static_cast<juce::int64>(numChannels))
+        && stream.writeInt64(static_cast<juce::int64>(LOD_LEAF_SIZE));
+    
+    std::vector<double> level, above;
+    
+    for (std::uint64_t channel = 0; channel < numChannels && ok && numSamples > 0; ++channel)
+    {
+        auto ys = samples._xs + (channel + 1) * numSamples;
+        
+        // Leaves from the samples, then every level from the one below
+        level.assign(levelSizes[0] * 2, 0);
+        
+        for (std::size_t i = 0; i < levelSizes[0]; ++i)
+        {
+            auto min = std::numeric_limits<double>::infinity();
+            auto max = -min;
+            
+            for (auto k = i * LOD_LEAF_SIZE; k < std::min(numSamples, (i + 1) * LOD_LEAF_SIZE); ++k)
+            {
+                min = ys[k] < min ? ys[k] : min;
+                max = ys[k] > max ? ys[k] : max;
+            }
+            
+            level[2 * i] = min;
+            level[2 * i + 1] = max;
+        }
+        
+        for (std::size_t l = 0; l < levelSizes.size() && ok; ++l)
+        {
+            ok = stream.write(level.data(), level.size() * sizeof(double));
+            
+            if (l + 1 == levelSizes.size())
+                break;
+            
+            above.assign(levelSizes[l + 1] * 2, 0);
+            
+            for (std::size_t i = 0; i < levelSizes[l + 1]; ++i)
+            {
+                auto last = std::min(2 * i + 1, levelSizes[l] - 1);
+                above[2 * i] = std::min(level[4 * i], level[2 * last]);
+                above[2 * i + 1] = std::max(level[4 * i + 1], level[2 * last + 1]);
+            }
+            
+            std::swap(level, above);
+        }
+    }
+    
+    stream.flush();
+    return ok ? stream.getStatus() : juce::Result::fail("Could not write " + lodFile.getFullPathName());
+}
+
+/************************* TESTS ***************************/
+
+#if JUCE_UNIT_TESTS
+
+class SeriesTests : public juce::UnitTest
+{
+public:
+    SeriesTests() : juce::UnitTest("aot_juceplot series")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest("PlotSamples envelope against every sample");
+
+        juce::Random random(0x5eed);
+        std::vector<double> ys(200000);
+        PlotSamples samples;
+
+        for (std::size_t i = 0; i < ys.size(); ++i)
+        {
+            // Noise with rare spikes, and a gap
+            ys[i] = random.nextDouble() + (random.nextInt(5000) == 0 ? 50 * (random.nextDouble() - 0.5) : 0);
+            if (i >= 70000 && i < 70100)
+                ys[i] = std::numeric_limits<double>::quiet_NaN();
+
+            samples.pushBack(static_cast<double>(i), ys[i]);
+        }
+
+        std::vector<ColumnEnvelope> columns;
+
+        for (auto round = 0; round < 50; ++round)
+        {
+            auto numColumns = static_cast<std::size_t>(1 + random.nextInt(1000));
+            auto loX = random.nextDouble() * ys.size() * 0.5;
+            auto width = (ys.size() - loX) * (0.1 + 0.9 * random.nextDouble());
+
+            std::vector<double> edges(numColumns + 1);
+            for (std::size_t i = 0; i <= numColumns; ++i)
+                edges[i] = loX + width * i / numColumns;
+
+            columns.resize(numColumns);
+            if (! samples.envelope(edges.data(), numColumns, columns.data()))
+                continue;
+
+            expectColumns(ys, edges, columns);
+        }
+
+        beginTest("PlotSamples envelope of sparse samples");
+
+        // 500 samples over 1000 columns
+        std::vector<double> edges(1001);
+        columns.resize(1000);
+
+        for (std::size_t i = 0; i <= 1000; ++i)
+            edges[i] = 1000.0 + i * 0.5;
+
+        expect(! samples.envelope(edges.data(), 1000, columns.data()));
+
+        beginTest("M4Samples envelope starts at the first column");
+
+        // Bucket k holds y = k at x = k + 0.5, bucket 9 lies left of the columns
+        M4Samples decimated(1.0);
+        for (auto k = 0; k < 100; ++k)
+            decimated.pushBack(k + 0.5, k);
+
+        edges = { 10.2, 28.16, 46.12, 64.08, 82.04, 100 };
+        columns.resize(5);
+
+        expect(decimated.envelope(edges.data(), 5, columns.data()));
+        expectEquals(columns[0].first, 10.0);
+        expectEquals(columns[0].min, 10.0);
+        expectEquals(columns[4].max, 99.0);
+
+        beginTest("M4Samples envelope declines below 2 buckets per column");
+
+        // 10 buckets over 10 columns are drawn from evaluate(), over 5 columns they are merged
+        edges.resize(11);
+        columns.resize(10);
+
+        for (auto i = 0; i <= 10; ++i)
+            edges[static_cast<std::size_t>(i)] = 10.0 + i;
+
+        expect(! decimated.envelope(edges.data(), 10, columns.data()));
+
+        edges.resize(6);
+
+        for (auto i = 0; i <= 5; ++i)
+            edges[static_cast<std::size_t>(i)] = 10.0 + 2 * i;
+
+        expect(decimated.envelope(edges.data(), 5, columns.data()));
+    }
+
+private:
+    void expectColumns(const std::vector<double>& ys, const std::vector<double>& edges, const std::vector<ColumnEnvelope>& columns)
+    {
+        auto numWrong = 0;
+
+        for (std::size_t i = 0; i < columns.size(); ++i)
+        {
+            // Sample k lies at x = k
+            auto from = static_cast<std::size_t>(std::max(0.0, std::ceil(edges[i])));
+            auto to = std::min(ys.size(), static_cast<std::size_t>(std::max(0.0, std::ceil(edges[i + 1]))));
+
+            auto min = std::numeric_limits<double>::infinity();
+            auto max = -min;
+
+            for (auto k = from; k < to; ++k)
+            {
+                if (ys[k] < min) min = ys[k];
+                if (ys[k] > max) max = ys[k];
+            }
+
+            auto& column = columns[i];
+
+            if (from >= to)
+                numWrong += std::isnan(column.min) ? 0 : 1;
+            else if (min > max)
+                numWrong += std::isnan(column.min) && std::isnan(column.max) ? 0 : 1;
+            else
+                numWrong += column.min == min && column.max == max && equal(column.first, ys[from]) && equal(column.last, ys[to - 1]) ? 0 : 1;
+        }
+
+        expectEquals(numWrong, 0);
+    }
+
+    static bool equal(double a, double b)
+    {
+        return a == b || (std::isnan(a) && std::isnan(b));
+    }
+};
+
+static SeriesTests seriesTests;
+
+#endif
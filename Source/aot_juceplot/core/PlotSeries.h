@@ -0,0 +1,675 @@
+#pragma once
+
+/*
+    The newest capacity samples, x increasing. Memory stays the same however
+    many samples pass through: once full, a new sample overwrites the oldest.
+    Evaluated like PlotSamples, without the min/max pyramid: envelope() scans
+    the samples of the plotted range.
+*/
+class CircularSamples
+{
+public:
+    explicit CircularSamples(std::size_t capacity = 0) : _samples(capacity)
+    {
+    }
+    
+    void pushBack(double x, double y)
+    {
+        auto capacity = _samples.size();
+        jassert(capacity > 0);
+        
+        _samples[(_begin + _size) % capacity] = { x, y };
+        
+        if (_size < capacity)
+            ++_size;
+        else
+            _begin = (_begin + 1) % capacity;
+    }
+    
+    std::size_t size() const
+    {
+        return _size;
+    }
+    
+    std::size_t getCapacity() const
+    {
+        return _samples.size();
+    }
+    
+    /* x of the newest sample, -infinity while there is none */
+    double getLastX() const
+    {
+        return _size == 0 ? -std::numeric_limits<double>::infinity() : at(_size - 1).getX();
+    }
+    
+    double operator[](double i) const
+    {
+        return SampleSeries<CircularSamples>(*this)[i];
+    }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        SampleSeries<CircularSamples>(*this).evaluate(xs, ys, n);
+    }
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        return SampleSeries<CircularSamples>(*this).envelope(edges, numColumns, columns);
+    }
+    
+private:
+    friend class SampleSeries<CircularSamples>;
+    
+    /* Sample i, counted from the oldest */
+    const juce::Point<double>& at(std::size_t i) const
+    {
+        auto index = _begin + i;
+        return _samples[index < _samples.size() ? index : index - _samples.size()];
+    }
+    
+    double getX(std::size_t index) const
+    {
+        return at(index).getX();
+    }
+    
+    double getY(std::size_t index) const
+    {
+        return at(index).getY();
+    }
+    
+    std::vector<juce::Point<double>> _samples;
+    std::size_t _begin = 0;
+    std::size_t _size = 0;
+};
+
+/*
+    Append-only samples reduced as they arrive to the first, last, min and max y
+    of every x bucket (M4 aggregation). Level 0 has buckets of the given
+    resolution, every level above buckets twice as wide. A sample is merged
+    into every level, so pushBack() costs O(levels), which grows with the log
+    of the x span, not with the number of samples. envelope() merges the buckets of the coarsest level with
+    at least 16 per pixel column, so drawing a range costs O(width) and a new
+    range only picks another level.
+
+    Only the buckets are stored: zoomed in to fewer than 2 buckets per column,
+    envelope() declines and the curve, drawn from evaluate(), runs straight
+    from the first to the last sample of every bucket. Non-finite y are
+    skipped.
+
+    Like PlotSamples it is a value: a plot draws the copy it was given, as it
+    was then. For samples that keep arriving, hand it to LiveSamples and push
+    them there, the plot then shows the buckets they are drained into.
+*/
+class M4Samples
+{
+public:
+    /* resolution is the x width of the finest buckets */
+    explicit M4Samples(double resolution = 1) : _resolution(resolution)
+    {
+        jassert(resolution > 0);
+    }
+    
+    void pushBack(double x, double y)
+    {
+        if (! std::isfinite(y))
+            return;
+        
+        jassert(x >= _lastX);
+        _lastX = x;
+        
+        // Buckets are counted from the first one, so they always merge in pairs
+        if (_levels.empty())
+            _origin = std::floor(x / _resolution) * _resolution;
+        
+        auto index = getIndex(x);
+        
+        for (std::size_t level = 0; ; ++level, index /= 2)
+        {
+            if (level == _levels.size())
+            {
+                // A new top level once the one below has two buckets
+                if (level > 0 && _levels[level - 1].size() < 2)
+                    return;
+                
+                _levels.emplace_back();
+                
+                if (level > 0)
+                {
+                    for (auto& bucket : _levels[level - 1])
+                        merge(_levels[level], bucket.index / 2, bucket);
+                    
+                    continue;
+                }
+            }
+            
+            merge(_levels[level], index, { index, x, x, y, y, y, y });
+        }
+    }
+    
+    void pushBack(const double* xs, const double* ys, std::size_t n)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            pushBack(xs[i], ys[i]);
+    }
+    
+    /* Number of buckets at the finest level */
+    std::size_t size() const
+    {
+        return _levels.empty() ? 0 : _levels[0].size();
+    }
+    
+    /* x of the newest sample, -infinity while there is none */
+    double getLastX() const
+    {
+        return _lastX;
+    }
+    
+    double operator[](double x) const
+    {
+        double y;
+        evaluate(&x, &y, 1, EXACT);
+        return y;
+    }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        auto nan = std::numeric_limits<double>::quiet_NaN();
+        
+        if (_levels.empty())
+        {
+            std::fill(ys, ys + n, nan);
+            return;
+        }
+        
+        auto& buckets = _levels[0];
+        auto lastXBefore = [](const Bucket& bucket, double x) { return bucket.lastX < x; };
+        auto cursor = buckets.begin();
+        
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto x = xs[i];
+            
+            // Going backwards starts over
+            if (cursor != buckets.begin() && std::prev(cursor)->lastX >= x)
+                cursor = buckets.begin();
+            
+            cursor = std::lower_bound(cursor, buckets.end(), x, lastXBefore);
+            
+            if (cursor == buckets.end() || x < buckets.front().firstX)
+                ys[i] = nan;
+            else if (x >= cursor->firstX)
+                ys[i] = interpolate(cursor->firstX, cursor->first, cursor->lastX, cursor->last, x);
+            else
+                ys[i] = interpolate(std::prev(cursor)->lastX, std::prev(cursor)->last, cursor->firstX, cursor->first, x);
+        }
+    }
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        if (_levels.empty() || numColumns == 0)
+            return false;
+        
+        auto indexBefore = [](const Bucket& bucket, juce::int64 index) { return bucket.index < index; };
+        
+        // Sparse buckets are drawn as they are by interpolating them
+        auto& finest = _levels[0];
+        auto begin = std::lower_bound(finest.begin(), finest.end(), getIndex(edges[0]), indexBefore);
+        auto end = std::lower_bound(begin, finest.end(), getIndex(edges[numColumns]), indexBefore);
+        
+        if (static_cast<std::size_t>(end - begin) < 2 * numColumns)
+            return false;
+        
+        auto columnWidth = (edges[numColumns] - edges[0]) / numColumns;
+        
+        std::size_t level = 0;
+        auto width = _resolution;
+        
+        while (level + 1 < _levels.size() && 2 * width * BUCKETS_PER_COLUMN <= columnWidth)
+        {
+            ++level;
+            width *= 2;
+        }
+        
+        // The first bucket with its middle at or after edges[0]
+        auto& buckets = _levels[level];
+        auto first = static_cast<juce::int64>(std::ceil((edges[0] - _origin) / width - 0.5));
+        auto cursor = std::lower_bound(buckets.begin(), buckets.end(), first, indexBefore);
+        
+        auto nan = std::numeric_limits<double>::quiet_NaN();
+        
+        // A bucket belongs to the column its middle is in
+        for (std::size_t i = 0; i < numColumns; ++i)
+        {
+            columns[i] = { nan, nan, nan, nan };
+            auto empty = true;
+            
+            for (; cursor != buckets.end() && _origin + (cursor->index + 0.5) * width < edges[i + 1]; ++cursor)
+            {
+                auto& column = columns[i];
+                
+                if (empty)
+                    column = { cursor->first, cursor->last, cursor->min, cursor->max };
+                
+                column.last = cursor->last;
+                column.min = std::min(column.min, cursor->min);
+                column.max = std::max(column.max, cursor->max);
+                empty = false;
+            }
+        }
+        
+        return true;
+    }
+    
+private:
+    // Fewest buckets merged into a column: peaks land within 1/16 of a column
+    static const int BUCKETS_PER_COLUMN = 16;
+    
+    /* Index of the finest bucket x falls into */
+    juce::int64 getIndex(double x) const
+    {
+        return static_cast<juce::int64>(std::floor((x - _origin) / _resolution));
+    }
+    
+    struct Bucket
+    {
+        juce::int64 index;
+        double firstX, lastX;
+        double first, last, min, max;
+    };
+    
+    /* Adds bucket to the last one of buckets, or starts a new one at index */
+    static void merge(std::vector<Bucket>& buckets, juce::int64 index, const Bucket& bucket)
+    {
+        if (buckets.empty() || buckets.back().index != index)
+        {
+            buckets.push_back(bucket);
+            buckets.back().index = index;
+            return;
+        }
+        
+        auto& last = buckets.back();
+        last.lastX = bucket.lastX;
+        last.last = bucket.last;
+        last.min = std::min(last.min, bucket.min);
+        last.max = std::max(last.max, bucket.max);
+    }
+    
+    static double interpolate(double x0, double y0, double x1, double y1, double x)
+    {
+        return x1 > x0 ? (y0 * (x1 - x) + y1 * (x - x0)) / (x1 - x0) : y1;
+    }
+    
+    double _resolution;
+    double _origin = 0;
+    double _lastX = -std::numeric_limits<double>::infinity();
+    std::vector<std::vector<Bucket>> _levels;
+};
+
+/*
+    Samples streamed into a plot from a real-time thread, e.g. an audio callback.
+
+    One thread pushes and one thread drains. Pushing copies into a FIFO that is
+    allocated up front: it never locks, waits or allocates, and samples that
+    arrive while the FIFO is full are dropped and counted. Draining moves them
+    into the PlotSamples the plot shows. Copies of a LiveSamples share the same
+    samples, so the producer keeps one and the plot gets another.
+
+    With a capacity, only the newest capacity samples are kept, in constant
+    memory, e.g. for a strip chart that runs for days. Given an M4Samples,
+    samples are only kept as its per bucket summaries.
+
+    The samples shown are kept twice. Draining fills the copy no thread reads
+    and then shows it, while readers on other threads, e.g. background frames,
+    finish with the one they started on: neither side waits for the other,
+    and neither locks. Readers count themselves on the copy they read, and a
+    drain that finds readers left on the other copy leaves the samples in the
+    FIFO for the next one.
+*/
+class LiveSamples
+{
+public:
+    explicit LiveSamples(int fifoSize = 1 << 16, std::size_t capacity = 0)
+        : _buffer(std::make_shared<Buffer>(fifoSize, Storage(capacity > 0 ? RECENT : ALL)))
+    {
+        for (auto& copy : _buffer->copies)
+            copy.recent = CircularSamples(capacity);
+    }
+    
+    /* Drained into decimated, for rates too high to keep every sample */
+    LiveSamples(int fifoSize, M4Samples decimated) : _buffer(std::make_shared<Buffer>(fifoSize, Storage(DECIMATED)))
+    {
+        for (auto& copy : _buffer->copies)
+            copy.decimated = decimated;
+    }
+    
+    /* Producer side: n samples, x increasing. Returns the number that fit into the FIFO */
+    int push(const double* xs, const double* ys, int n)
+    {
+        return write(n, [xs, ys](int i, double& x, double& y)
+        {
+            x = xs[i];
+            y = ys[i];
+        });
+    }
+    
+    /* Producer side: ys[i] at startX + i * deltaX, e.g. an audio block at the times of its samples */
+    int push(double startX, double deltaX, const float* ys, int n)
+    {
+        return write(n, [startX, deltaX, ys](int i, double& x, double& y)
+        {
+            x = startX + i * deltaX;
+            y = ys[i];
+        });
+    }
+    
+    /*
+        Consumer side: moves the samples pushed so far to the ones shown, returns
+        how many. While another thread still reads the copy shown before the last
+        drain, they are left in the FIFO and 0 is returned.
+    */
+    int drain()
+    {
+        auto& buffer = *_buffer;
+        
+        // Only the consumer changes which copy is shown, the other one is free once its readers are gone
+        auto spareIndex = 1 - buffer.shown.load(std::memory_order_relaxed);
+        
+        if (buffer.numReaders[spareIndex].load() > 0)
+            return 0;
+        
+        auto& spare = buffer.copies[spareIndex];
+        
+        // What the last drain added to the other copy
+        for (std::size_t i = 0; i < buffer.drainedXs.size(); ++i)
+            spare.pushBack(buffer.drainedXs[i], buffer.drainedYs[i]);
+        
+        buffer.drainedXs.clear();
+        buffer.drainedYs.clear();
+        
+        int start1, size1, start2, size2;
+        buffer.fifo.prepareToRead(buffer.fifo.getNumReady(), start1, size1, start2, size2);
+        
+        for (auto i = start1; i < start1 + size1; ++i)
+            buffer.drain(spare, i);
+        
+        for (auto i = start2; i < start2 + size2; ++i)
+            buffer.drain(spare, i);
+        
+        buffer.fifo.finishedRead(size1 + size2);
+        
+        buffer.shown.store(spareIndex);
+        return size1 + size2;
+    }
+    
+    /* True if pushed samples wait to be drained, safe on either side */
+    bool hasPending() const
+    {
+        return _buffer->fifo.getNumReady() > 0;
+    }
+    
+    /* Samples pushed while the FIFO was full */
+    int getNumDropped() const
+    {
+        return _buffer->numDropped.load();
+    }
+    
+    /* The samples kept, buckets for M4Samples */
+    std::size_t size() const
+    {
+        return visit([](const auto& samples) { return samples.size(); });
+    }
+    
+    /* x of the newest sample drained, -infinity while there is none */
+    double getLastX() const
+    {
+        return visit([](const auto& samples) { return samples.getLastX(); });
+    }
+    
+    double operator[](double i) const
+    {
+        return visit([i](const auto& samples) { return samples[i]; });
+    }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision precision) const
+    {
+        visit([=](const auto& samples) { samples.evaluate(xs, ys, n, precision); });
+    }
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        return visit([=](const auto& samples) { return samples.envelope(edges, numColumns, columns); });
+    }
+    
+private:
+    /* Where drained samples go */
+    enum Kind
+    {
+        ALL,        // PlotSamples
+        RECENT,     // CircularSamples
+        DECIMATED   // M4Samples
+    };
+    
+    /* One copy of the samples shown, only the one kind says is used */
+    struct Storage
+    {
+        explicit Storage(Kind kind) : kind(kind)
+        {
+        }
+        
+        template <typename FunctionT>
+        auto visit(FunctionT function) const -> decltype(function(std::declval<const PlotSamples&>()))
+        {
+            switch (kind)
+            {
+                case RECENT:    return function(recent);
+                case DECIMATED: return function(decimated);
+                default:        return function(samples);
+            }
+        }
+        
+        void pushBack(double x, double y)
+        {
+            switch (kind)
+            {
+                case RECENT:    recent.pushBack(x, y); break;
+                case DECIMATED: decimated.pushBack(x, y); break;
+                default:        samples.pushBack(x, y); break;
+            }
+        }
+        
+        Kind kind;
+        PlotSamples samples;
+        CircularSamples recent;
+        M4Samples decimated;
+    };
+    
+    struct Buffer
+    {
+        Buffer(int fifoSize, const Storage& storage)
+            : fifo(fifoSize), xs(static_cast<std::size_t>(fifoSize)), ys(static_cast<std::size_t>(fifoSize)),
+              copies { storage, storage }
+        {
+        }
+        
+        /* Moves FIFO entry i into spare, to be added to the other copy by the next drain */
+        void drain(Storage& spare, int i)
+        {
+            spare.pushBack(xs[i], ys[i]);
+            drainedXs.push_back(xs[i]);
+            drainedYs.push_back(ys[i]);
+        }
+        
+        juce::AbstractFifo fifo;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        std::atomic<int> numDropped { 0 };
+        
+        // The copy shown is switched by the consumer, the readers of each are counted by themselves
+        Storage copies[2];
+        std::atomic<int> shown { 0 };
+        std::atomic<int> numReaders[2] { { 0 }, { 0 } };
+        std::vector<double> drainedXs;
+        std::vector<double> drainedYs;
+    };
+    
+    /* Counted as a reader of the copy shown while it lives, a drain meanwhile fills and shows the other */
+    class Reader
+    {
+    public:
+        explicit Reader(Buffer& buffer) : _buffer(buffer)
+        {
+            // Still shown after counting in, the next drain sees the count; else it may be filling it already
+            for (;;)
+            {
+                _index = buffer.shown.load();
+                ++buffer.numReaders[_index];
+                
+                if (buffer.shown.load() == _index)
+                    break;
+                
+                --buffer.numReaders[_index];
+            }
+        }
+        
+        ~Reader()
+        {
+            --_buffer.numReaders[_index];
+        }
+        
+        const Storage& getStorage() const
+        {
+            return _buffer.copies[_index];
+        }
+        
+    private:
+        Buffer& _buffer;
+        int _index;
+        
+        JUCE_DECLARE_NON_COPYABLE (Reader)
+    };
+    
+    template <typename FunctionT>
+    auto visit(FunctionT function) const -> decltype(function(std::declval<const PlotSamples&>()))
+    {
+        Reader reader(*_buffer);
+        return reader.getStorage().visit(function);
+    }
+    
+    template <typename SampleT>
+    int write(int n, SampleT sample)
+    {
+        auto& buffer = *_buffer;
+        int start1, size1, start2, size2;
+        buffer.fifo.prepareToWrite(n, start1, size1, start2, size2);
+        
+        for (auto i = 0; i < size1; ++i)
+            sample(i, buffer.xs[start1 + i], buffer.ys[start1 + i]);
+        
+        for (auto i = 0; i < size2; ++i)
+            sample(size1 + i, buffer.xs[start2 + i], buffer.ys[start2 + i]);
+        
+        buffer.fifo.finishedWrite(size1 + size2);
+        
+        auto written = size1 + size2;
+        if (written < n)
+            buffer.numDropped += n - written;
+        
+        return written;
+    }
+    
+    std::shared_ptr<Buffer> _buffer;
+};
+
+/*
+    One channel of a series file, mapped into memory rather than read: opening
+    is instant whatever the size, and only the pages of the plotted range are
+    ever read from disk. Copies share the mapping.
+
+    Series file, native doubles in little-endian order:
+
+        char[8]                     "AOTPLOT1"
+        uint64                      numSamples
+        uint64                      numChannels
+        double[numSamples]          x, increasing
+        double[numSamples]          y of channel 0
+        ...                         y of the other channels
+
+    An optional sidecar, named like the file with ".lod" appended, holds the
+    min/max pyramid of every channel, see writeLod(). Without it envelope() reads every sample in
+    the plotted range, with it a pixel column costs O(log n) however many
+    samples it covers.
+*/
+class MappedSamples
+{
+public:
+    /* isValid() is false if file is not a series file or has no such channel */
+    explicit MappedSamples(const juce::File& file, int channel = 0);
+    
+    bool isValid() const
+    {
+        return _xs != nullptr;
+    }
+    
+    bool hasLod() const
+    {
+        return ! _levels.empty();
+    }
+    
+    std::size_t size() const
+    {
+        return _size;
+    }
+    
+    /* x of the newest sample, -infinity while there is none */
+    double getLastX() const
+    {
+        return _size == 0 ? -std::numeric_limits<double>::infinity() : _xs[_size - 1];
+    }
+    
+    double operator[](double x) const
+    {
+        return SampleSeries<MappedSamples>(*this)[x];
+    }
+    
+    void evaluate(const double* xs, double* ys, std::size_t n, Precision) const
+    {
+        SampleSeries<MappedSamples>(*this).evaluate(xs, ys, n);
+    }
+    
+    bool envelope(const double* edges, std::size_t numColumns, ColumnEnvelope* columns) const
+    {
+        return SampleSeries<MappedSamples>(*this).envelope(edges, numColumns, columns);
+    }
+    
+    /* Writes n samples of numChannels channels, ys[channel][i] */
+    static juce::Result write(const juce::File& file, const double* xs, const double* const* ys, int numChannels, std::size_t n);
+    
+    /* Writes the min/max pyramid of every channel of file into its sidecar */
+    static juce::Result writeLod(const juce::File& file);
+    
+private:
+    friend class SampleSeries<MappedSamples>;
+    
+    double getX(std::size_t index) const
+    {
+        return _xs[index];
+    }
+    
+    double getY(std::size_t index) const
+    {
+        return _ys[index];
+    }
+    
+    /* Min and max of y over the samples [begin, end) */
+    void findRange(std::size_t begin, std::size_t end, double& min, double& max) const;
+    
+    std::shared_ptr<juce::MemoryMappedFile> _file;
+    std::shared_ptr<juce::MemoryMappedFile> _lod;
+    
+    const double* _xs = nullptr;
+    const double* _ys = nullptr;
+    std::size_t _size = 0;
+    
+    // Min/max pairs of every level of the pyramid, this channel's
+    std::vector<const double*> _levels;
+};
@@ -0,0 +1,508 @@
+namespace simd {
+
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define AOT_PLOT_TARGET_SSE2 __attribute__((target("sse2")))
+ #define AOT_PLOT_TARGET_AVX2 __attribute__((target("avx2")))
+ // Pulls the generic kernel and the pack operations into the ISA specific entry point
+ #define AOT_PLOT_FLATTEN __attribute__((flatten))
+#else
+ #define AOT_PLOT_TARGET_SSE2
+ #define AOT_PLOT_TARGET_AVX2
+ #define AOT_PLOT_FLATTEN
+#endif
+
+/* -------------------------------------------------------- */
+// Packs: the minimal set of lane-wise operations the kernels are written in
+
+struct ScalarPack
+{
+    typedef double Vec;
+    typedef std::int64_t Int;
+    static const std::size_t width = 1;
+
+    static Vec load(const double* p)        { return *p; }
+    static void store(double* p, Vec v)     { *p = v; }
+    static Vec set(double v)                { return v; }
+
+    static Vec add(Vec a, Vec b)            { return a + b; }
+    static Vec sub(Vec a, Vec b)            { return a - b; }
+    static Vec mul(Vec a, Vec b)            { return a * b; }
+    static Vec div(Vec a, Vec b)            { return a / b; }
+
+    static Int iset(std::int64_t v)         { return v; }
+    static Int iadd(Int a, Int b)           { return a + b; }
+    static Int isub(Int a, Int b)           { return a - b; }
+    static Int iand(Int a, Int b)           { return a & b; }
+    static Int ior(Int a, Int b)            { return a | b; }
+
+    template <int bits> static Int shl(Int a) { return static_cast<Int>(static_cast<std::uint64_t>(a) << bits); }
+    template <int bits> static Int shr(Int a) { return static_cast<Int>(static_cast<std::uint64_t>(a) >> bits); }
+
+    static Int bits(Vec v)                  { Int i; std::memcpy(&i, &v, sizeof(i)); return i; }
+    static Vec vec(Int i)                   { Vec v; std::memcpy(&v, &i, sizeof(v)); return v; }
+    static Vec flipSign(Vec v, Int sign)    { return vec(bits(v) ^ sign); }
+
+    static Int greater(Vec a, Vec b)        { return a > b ? -1 : 0; }
+    static Vec select(Int mask, Vec a, Vec b) { return mask ? a : b; }
+    static bool within(Vec v, double lo, double hi) { return v >= lo && v <= hi; }
+};
+
+#if JUCE_INTEL
+
+struct Sse2Pack
+{
+    typedef __m128d Vec;
+    typedef __m128i Int;
+    static const std::size_t width = 2;
+
+    AOT_PLOT_TARGET_SSE2 static Vec load(const double* p)        { return _mm_loadu_pd(p); }
+    AOT_PLOT_TARGET_SSE2 static void store(double* p, Vec v)     { _mm_storeu_pd(p, v); }
+    AOT_PLOT_TARGET_SSE2 static Vec set(double v)                { return _mm_set1_pd(v); }
+
+    AOT_PLOT_TARGET_SSE2 static Vec add(Vec a, Vec b)            { return _mm_add_pd(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Vec sub(Vec a, Vec b)            { return _mm_sub_pd(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Vec mul(Vec a, Vec b)            { return _mm_mul_pd(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Vec div(Vec a, Vec b)            { return _mm_div_pd(a, b); }
+
+    AOT_PLOT_TARGET_SSE2 static Int iset(std::int64_t v)         { return _mm_set1_epi64x(v); }
+    AOT_PLOT_TARGET_SSE2 static Int iadd(Int a, Int b)           { return _mm_add_epi64(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Int isub(Int a, Int b)           { return _mm_sub_epi64(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Int iand(Int a, Int b)           { return _mm_and_si128(a, b); }
+    AOT_PLOT_TARGET_SSE2 static Int ior(Int a, Int b)            { return _mm_or_si128(a, b); }
+
+    template <int bits> AOT_PLOT_TARGET_SSE2 static Int shl(Int a) { return _mm_slli_epi64(a, bits); }
+    template <int bits> AOT_PLOT_TARGET_SSE2 static Int shr(Int a) { return _mm_srli_epi64(a, bits); }
+
+    AOT_PLOT_TARGET_SSE2 static Int bits(Vec v)                  { return _mm_castpd_si128(v); }
+    AOT_PLOT_TARGET_SSE2 static Vec vec(Int i)                   { return _mm_castsi128_pd(i); }
+    AOT_PLOT_TARGET_SSE2 static Vec flipSign(Vec v, Int sign)    { return _mm_xor_pd(v, vec(sign)); }
+
+    AOT_PLOT_TARGET_SSE2 static Int greater(Vec a, Vec b)        { return bits(_mm_cmpgt_pd(a, b)); }
+
+    AOT_PLOT_TARGET_SSE2 static Vec select(Int mask, Vec a, Vec b)
+    {
+        return _mm_or_pd(_mm_and_pd(vec(mask), a), _mm_andnot_pd(vec(mask), b));
+    }
+
+    AOT_PLOT_TARGET_SSE2 static bool within(Vec v, double lo, double hi)
+    {
+        return _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(v, set(lo)), _mm_cmple_pd(v, set(hi)))) == 0x3;
+    }
+};
+
+struct Avx2Pack
+{
+    typedef __m256d Vec;
+    typedef __m256i Int;
+    static const std::size_t width = 4;
+
+    AOT_PLOT_TARGET_AVX2 static Vec load(const double* p)        { return _mm256_loadu_pd(p); }
+    AOT_PLOT_TARGET_AVX2 static void store(double* p, Vec v)     { _mm256_storeu_pd(p, v); }
+    AOT_PLOT_TARGET_AVX2 static Vec set(double v)                { return _mm256_set1_pd(v); }
+
+    AOT_PLOT_TARGET_AVX2 static Vec add(Vec a, Vec b)            { return _mm256_add_pd(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Vec sub(Vec a, Vec b)            { return _mm256_sub_pd(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Vec mul(Vec a, Vec b)            { return _mm256_mul_pd(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Vec div(Vec a, Vec b)            { return _mm256_div_pd(a, b); }
+
+    AOT_PLOT_TARGET_AVX2 static Int iset(std::int64_t v)         { return _mm256_set1_epi64x(v); }
+    AOT_PLOT_TARGET_AVX2 static Int iadd(Int a, Int b)           { return _mm256_add_epi64(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Int isub(Int a, Int b)           { return _mm256_sub_epi64(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Int iand(Int a, Int b)           { return _mm256_and_si256(a, b); }
+    AOT_PLOT_TARGET_AVX2 static Int ior(Int a, Int b)            { return _mm256_or_si256(a, b); }
+
+    template <int bits> AOT_PLOT_TARGET_AVX2 static Int shl(Int a) { return _mm256_slli_epi64(a, bits); }
+    template <int bits> AOT_PLOT_TARGET_AVX2 static Int shr(Int a) { return _mm256_srli_epi64(a, bits); }
+
+    AOT_PLOT_TARGET_AVX2 static Int bits(Vec v)                  { return _mm256_castpd_si256(v); }
+    AOT_PLOT_TARGET_AVX2 static Vec vec(Int i)                   { return _mm256_castsi256_pd(i); }
+    AOT_PLOT_TARGET_AVX2 static Vec flipSign(Vec v, Int sign)    { return _mm256_xor_pd(v, vec(sign)); }
+
+    AOT_PLOT_TARGET_AVX2 static Int greater(Vec a, Vec b)        { return bits(_mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+
+    AOT_PLOT_TARGET_AVX2 static Vec select(Int mask, Vec a, Vec b)
+    {
+        return _mm256_blendv_pd(b, a, vec(mask));
+    }
+
+    AOT_PLOT_TARGET_AVX2 static bool within(Vec v, double lo, double hi)
+    {
+        auto inside = _mm256_and_pd(_mm256_cmp_pd(v, set(lo), _CMP_GE_OQ), _mm256_cmp_pd(v, set(hi), _CMP_LE_OQ));
+        return _mm256_movemask_pd(inside) == 0xF;
+    }
+};
+
+#endif
+
+/* -------------------------------------------------------- */
+// Generic kernels
+
+// 1.5 * 2^52: adding it rounds to an integer that ends up in the low mantissa bits
+static const double ROUNDING_MAGIC = 6755399441055744.0;
+
+template <typename P>
+static typename P::Vec polynomial(const typename P::Vec& x, const double* coefficients, int count)
+{
+    auto result = P::set(coefficients[count - 1]);
+    for (int i = count - 2; i >= 0; --i)
+        result = P::add(P::mul(result, x), P::set(coefficients[i]));
+
+    return result;
+}
+
+struct Add
+{
+    template <typename P>
+    static typename P::Vec apply(const typename P::Vec& a, const typename P::Vec& b) { return P::add(a, b); }
+};
+
+struct Multiply
+{
+    template <typename P>
+    static typename P::Vec apply(const typename P::Vec& a, const typename P::Vec& b) { return P::mul(a, b); }
+};
+
+// Shared by sin and cos, cos is sin shifted by one quadrant
+template <int quadrantOffset>
+struct SinCos
+{
+    static constexpr double lo = -1e5;
+    static constexpr double hi = 1e5;
+
+    template <typename P>
+    static typename P::Vec apply(const typename P::Vec& x)
+    {
+        // Cody-Waite reduction to |r| <= pi/4 with pi/2 split into fdlibm's three 33 bit parts,
+        // the first two products are exact for |q| < 2^20
+        static const double twoOverPi = 6.36619772367581382433e-01;
+        static const double pio2_1 = 1.57079632673412561417e+00;
+        static const double pio2_2 = 6.07710050630396597660e-11;
+        static const double pio2_3 = 2.02226624871116645580e-21;
+
+        // fdlibm __kernel_sin / __kernel_cos minimax coefficients on [-pi/4, pi/4]
+        static const double sinCoefficients[] = {
+            -1.66666666666666324348e-01, 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+            2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10 };
+        static const double cosCoefficients[] = {
+            4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+            -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11 };
+
+        auto magic = P::set(ROUNDING_MAGIC);
+        auto t = P::add(P::mul(x, P::set(twoOverPi)), magic);
+        auto q = P::sub(t, magic);
+        auto quadrant = P::iadd(P::bits(t), P::iset(quadrantOffset));
+
+        auto r = P::sub(x, P::mul(q, P::set(pio2_1)));
+        r = P::sub(r, P::mul(q, P::set(pio2_2)));
+        r = P::sub(r, P::mul(q, P::set(pio2_3)));
+
+        auto z = P::mul(r, r);
+        auto s = P::add(r, P::mul(P::mul(r, z), polynomial<P>(z, sinCoefficients, 6)));
+        auto c = P::add(P::sub(P::set(1.0), P::mul(z, P::set(0.5))),
+                        P::mul(P::mul(z, z), polynomial<P>(z, cosCoefficients, 6)));
+
+        // Odd quadrants use the cosine branch, quadrants 2 and 3 flip the sign
+        auto odd = P::isub(P::iset(0), P::iand(quadrant, P::iset(1)));
+        auto sign = P::template shl<62>(P::iand(quadrant, P::iset(2)));
+
+        return P::flipSign(P::select(odd, c, s), sign);
+    }
+};
+
+struct Exp
+{
+    static constexpr double lo = -708.0;
+    static constexpr double hi = 709.0;
+
+    template <typename P>
+    static typename P::Vec apply(const typename P::Vec& x)
+    {
+        static const double log2e = 1.44269504088896338700e+00;
+        static const double ln2Hi = 6.93147180369123816490e-01;
+        static const double ln2Lo = 1.90821492927058770002e-10;
+
+        // Taylor series of e^r for |r| <= ln2 / 2, truncation error < 2e-16
+        static const double coefficients[] = {
+            1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+            1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600 };
+
+        auto magic = P::set(ROUNDING_MAGIC);
+        auto t = P::add(P::mul(x, P::set(log2e)), magic);
+        auto k = P::sub(t, magic);
+
+        auto r = P::sub(x, P::mul(k, P::set(ln2Hi)));
+        r = P::sub(r, P::mul(k, P::set(ln2Lo)));
+
+        // 2^k built directly in the exponent bits
+        auto exponent = P::isub(P::bits(t), P::bits(magic));
+        auto scale = P::vec(P::template shl<52>(P::iadd(exponent, P::iset(1023))));
+
+        return P::mul(polynomial<P>(r, coefficients, 13), scale);
+    }
+};
+
+struct Log
+{
+    static constexpr double lo = std::numeric_limits<double>::min();
+    static constexpr double hi = std::numeric_limits<double>::max();
+
+    template <typename P>
+    static typename P::Vec apply(const typename P::Vec& x)
+    {
+        static const double sqrt2 = 1.41421356237309504880;
+        static const double ln2Hi = 6.93147180369123816490e-01;
+        static const double ln2Lo = 1.90821492927058770002e-10;
+
+        // log(m) = 2 atanh(f) with f = (m - 1) / (m + 1), |f| <= 0.172
+        static const double coefficients[] = {
+            2.0 / 3, 2.0 / 5, 2.0 / 7, 2.0 / 9, 2.0 / 11, 2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19 };
+
+        // x = m * 2^e with m in [sqrt(2)/2, sqrt(2))
+        auto bits = P::bits(x);
+        auto e = P::isub(P::template shr<52>(bits), P::iset(1023));
+        auto m = P::vec(P::ior(P::iand(bits, P::iset(0x000FFFFFFFFFFFFFLL)), P::bits(P::set(1.0))));
+
+        auto large = P::greater(m, P::set(sqrt2));
+        m = P::select(large, P::mul(m, P::set(0.5)), m);
+        e = P::isub(e, large);
+
+        auto one = P::set(1.0);
+        auto f = P::div(P::sub(m, one), P::add(m, one));
+        auto s = P::mul(f, f);
+        auto logM = P::add(P::add(f, f), P::mul(P::mul(f, s), polynomial<P>(s, coefficients, 9)));
+
+        auto magic = P::set(ROUNDING_MAGIC);
+        auto exponent = P::sub(P::vec(P::iadd(e, P::bits(magic))), magic);
+
+        return P::add(P::mul(exponent, P::set(ln2Hi)), P::add(logM, P::mul(exponent, P::set(ln2Lo))));
+    }
+};
+
+template <typename P, typename OperationT>
+static void binary(const double* lhs, const double* rhs, double* out, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + P::width <= n; i += P::width)
+        P::store(out + i, OperationT::template apply<P>(P::load(lhs + i), P::load(rhs + i)));
+
+    for (; i < n; ++i)
+        out[i] = OperationT::template apply<ScalarPack>(lhs[i], rhs[i]);
+}
+
+template <typename P, typename FunctionT>
+static void unary(const double* xs, double* ys, std::size_t n, double (*exact)(double))
+{
+    std::size_t i = 0;
+    for (; i + P::width <= n; i += P::width)
+    {
+        auto x = P::load(xs + i);
+        auto y = FunctionT::template apply<P>(x);
+
+        if (P::within(x, FunctionT::lo, FunctionT::hi))
+        {
+            P::store(ys + i, y);
+            continue;
+        }
+
+        // xs and ys may be the same buffer, keep the inputs for the libm fallback
+        double in[P::width];
+        P::store(in, x);
+        P::store(ys + i, y);
+
+        for (std::size_t j = 0; j < P::width; ++j)
+        {
+            if (! (in[j] >= FunctionT::lo && in[j] <= FunctionT::hi))
+                ys[i + j] = exact(in[j]);
+        }
+    }
+
+    for (; i < n; ++i)
+    {
+        auto x = xs[i];
+        ys[i] = (x >= FunctionT::lo && x <= FunctionT::hi) ? FunctionT::template apply<ScalarPack>(x) : exact(x);
+    }
+}
+
+static double exactSin(double x) { return std::sin(x); }
+static double exactCos(double x) { return std::cos(x); }
+static double exactExp(double x) { return std::exp(x); }
+static double exactLog(double x) { return std::log(x); }
+
+/* -------------------------------------------------------- */
+// Entry points per instruction set
+
+template <typename P>
+struct PackKernels
+{
+    static void add(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<P, Add>(lhs, rhs, out, n); }
+    static void multiply(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<P, Multiply>(lhs, rhs, out, n); }
+
+    static void sin(const double* xs, double* ys, std::size_t n) { unary<P, SinCos<0>>(xs, ys, n, exactSin); }
+    static void cos(const double* xs, double* ys, std::size_t n) { unary<P, SinCos<1>>(xs, ys, n, exactCos); }
+    static void exp(const double* xs, double* ys, std::size_t n) { unary<P, Exp>(xs, ys, n, exactExp); }
+    static void log(const double* xs, double* ys, std::size_t n) { unary<P, Log>(xs, ys, n, exactLog); }
+};
+
+#if JUCE_INTEL
+
+struct Sse2Kernels
+{
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void add(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<Sse2Pack, Add>(lhs, rhs, out, n); }
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void multiply(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<Sse2Pack, Multiply>(lhs, rhs, out, n); }
+
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void sin(const double* xs, double* ys, std::size_t n) { unary<Sse2Pack, SinCos<0>>(xs, ys, n, exactSin); }
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void cos(const double* xs, double* ys, std::size_t n) { unary<Sse2Pack, SinCos<1>>(xs, ys, n, exactCos); }
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void exp(const double* xs, double* ys, std::size_t n) { unary<Sse2Pack, Exp>(xs, ys, n, exactExp); }
+    AOT_PLOT_TARGET_SSE2 AOT_PLOT_FLATTEN
+    static void log(const double* xs, double* ys, std::size_t n) { unary<Sse2Pack, Log>(xs, ys, n, exactLog); }
+};
+
+struct Avx2Kernels
+{
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void add(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<Avx2Pack, Add>(lhs, rhs, out, n); }
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void multiply(const double* lhs, const double* rhs, double* out, std::size_t n) { binary<Avx2Pack, Multiply>(lhs, rhs, out, n); }
+
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void sin(const double* xs, double* ys, std::size_t n) { unary<Avx2Pack, SinCos<0>>(xs, ys, n, exactSin); }
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void cos(const double* xs, double* ys, std::size_t n) { unary<Avx2Pack, SinCos<1>>(xs, ys, n, exactCos); }
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void exp(const double* xs, double* ys, std::size_t n) { unary<Avx2Pack, Exp>(xs, ys, n, exactExp); }
+    AOT_PLOT_TARGET_AVX2 AOT_PLOT_FLATTEN
+    static void log(const double* xs, double* ys, std::size_t n) { unary<Avx2Pack, Log>(xs, ys, n, exactLog); }
+};
+
+#endif
+
+template <typename KernelsT>
+static Kernels makeKernels()
+{
+    return { KernelsT::add, KernelsT::multiply, KernelsT::sin, KernelsT::cos, KernelsT::exp, KernelsT::log };
+}
+
+static Kernels selectKernels()
+{
+   #if JUCE_INTEL
+    if (juce::SystemStats::hasAVX2())
+        return makeKernels<Avx2Kernels>();
+
+    if (juce::SystemStats::hasSSE2())
+        return makeKernels<Sse2Kernels>();
+   #endif
+
+    return makeKernels<PackKernels<ScalarPack>>();
+}
+
+const Kernels& getKernels()
+{
+    static const Kernels kernels = selectKernels();
+    return kernels;
+}
+
+/************************* TESTS ***************************/
+
+#if JUCE_UNIT_TESTS
+
+class SimdTests : public juce::UnitTest
+{
+public:
+    SimdTests() : juce::UnitTest("aot_juceplot SIMD kernels")
+    {
+    }
+
+    void runTest() override
+    {
+        expectAccuracy("scalar", makeKernels<PackKernels<ScalarPack>>());
+
+       #if JUCE_INTEL
+        if (juce::SystemStats::hasSSE2())
+            expectAccuracy("SSE2", makeKernels<Sse2Kernels>());
+
+        if (juce::SystemStats::hasAVX2())
+            expectAccuracy("AVX2", makeKernels<Avx2Kernels>());
+       #endif
+    }
+
+private:
+    enum Error { ABSOLUTE, RELATIVE };
+
+    static const int NUM_VALUES = 100000;
+
+    /* The bounds documented in PlotSimd.h */
+    void expectAccuracy(const juce::String& name, const Kernels& kernels)
+    {
+        beginTest(name + " kernels against libm");
+
+        juce::Random random(0x5eed);
+        std::vector<double> xs(NUM_VALUES);
+
+        for (auto& x : xs)
+            x = (2 * random.nextDouble() - 1) * 1e5;
+
+        expectWithin(name + " sin", kernels.sin, exactSin, xs, ABSOLUTE, 2.3e-16);
+        expectWithin(name + " cos", kernels.cos, exactCos, xs, ABSOLUTE, 2.3e-16);
+
+        for (auto& x : xs)
+            x = -708 + 1417 * random.nextDouble();
+
+        expectWithin(name + " exp", kernels.exp, exactExp, xs, RELATIVE, 5e-16);
+
+        for (auto& x : xs)
+            x = 0.5 + 1.5 * random.nextDouble();
+
+        expectWithin(name + " log near 1", kernels.log, exactLog, xs, ABSOLUTE, 1.2e-16);
+
+        // Spread over all exponents, [0.5, 2] left out
+        for (auto& x : xs)
+        {
+            do
+                x = std::exp(-708 + 1417 * random.nextDouble());
+            while (x >= 0.5 && x <= 2);
+        }
+
+        expectWithin(name + " log", kernels.log, exactLog, xs, RELATIVE, 2.3e-16);
+
+        // Outside the domains libm answers
+        auto nan = std::numeric_limits<double>::quiet_NaN();
+        auto infinity = std::numeric_limits<double>::infinity();
+
+        expectWithin(name + " sin outside", kernels.sin, exactSin, { nan, infinity, -2e5, 1e300 }, ABSOLUTE, 0);
+        expectWithin(name + " exp outside", kernels.exp, exactExp, { nan, infinity, -800, 800 }, ABSOLUTE, 0);
+        expectWithin(name + " log outside", kernels.log, exactLog, { nan, infinity, -1, 0, 1e-310 }, ABSOLUTE, 0);
+    }
+
+    void expectWithin(const juce::String& name, UnaryKernel kernel, double (*exact)(double),
+                      const std::vector<double>& xs, Error error, double bound)
+    {
+        std::vector<double> ys(xs.size());
+        kernel(xs.data(), ys.data(), xs.size());
+
+        auto worst = 0.0;
+
+        for (std::size_t i = 0; i < xs.size(); ++i)
+        {
+            auto y = exact(xs[i]);
+
+            if (ys[i] == y || (std::isnan(ys[i]) && std::isnan(y)))
+                continue;
+
+            auto e = std::abs(ys[i] - y) / (error == RELATIVE ? std::abs(y) : 1.0);
+            worst = e > worst || std::isnan(e) ? e : worst;
+        }
+
+        expect(worst <= bound, name + " off by " + juce::String(worst));
+    }
+};
+
+static SimdTests simdTests;
+
+#endif
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+    Block kernels used by the expression nodes. On Intel an SSE2 or AVX2 version
+    is picked at runtime, everywhere else a portable scalar version is used.
+
+    The fast math functions trade libm's last bits for throughput. Measured
+    against libm over their vectorised domain they stay within:
+
+        sin, cos    |x| <= 1e5          absolute error < 2.3e-16
+        exp         -708 <= x <= 709    relative error < 5e-16
+        log         0.5 <= x <= 2       absolute error < 1.2e-16
+                    other normal x > 0  relative error < 2.3e-16
+
+    Around its root at 1 log is small, so its relative error there grows, to
+    about 4e-16 on [0.5, 2].
+
+    Inputs outside those domains (including NaN and infinities) are handed to
+    libm, so results there are exact. Addition and multiplication are always
+    exact, their kernels are used regardless of the requested precision.
+*/
+
+/** Accuracy of the math functions used during evaluation */
+enum Precision
+{
+    EXACT,  // libm
+    FAST    // vectorised approximations
+};
+
+namespace simd {
+
+typedef void (*UnaryKernel)(const double* xs, double* ys, std::size_t n);
+typedef void (*BinaryKernel)(const double* lhs, const double* rhs, double* out, std::size_t n);
+
+struct Kernels
+{
+    BinaryKernel add;
+    BinaryKernel multiply;
+
+    UnaryKernel sin;
+    UnaryKernel cos;
+    UnaryKernel exp;
+    UnaryKernel log;
+};
+
+/* The best kernels for the cpu we are running on */
+const Kernels& getKernels();
+
+}
@@ -5,6 +5,8 @@ static const int BORDER_HEIGHT	= 20;
 static const int BORDER_WIDTH	= 20;
 static const int LEFT_BORDER	= 70;
 static const int MARK_LENGTH	= 4;
+static const int DRAFT_SPACING	= 4;	// pixels between samples in DRAFT quality
+static const double MAX_REFINE_ZOOM = 2;	// zoom at which cached samples are sampled anew
 
 double frexp10(double arg, int& exp)
 {
@@ -20,34 +22,400 @@ double frexp10(double arg, int& exp)
     return arg * pow(10 , -exp);
 }
 
-static String dtoa(double val, int precision, double rounding = 0)
+/* Rounding and precision of the labels of one axis, worked out once per axis */
+struct LabelFormat
 {
-    std::ostringstream ostr;
-    ostr.precision(precision);
-    if (rounding > 0)
+    LabelFormat(int precision, double rounding = 0) : _precision(precision)
     {
-        int exp;
-        frexp10(rounding, exp);
-        auto norm = std::pow(10, std::abs(exp));
-        val = std::lround(val * norm) / norm;
+        if (rounding > 0)
+        {
+            int exp;
+            frexp10(rounding, exp);
+            _norm = std::pow(10, std::abs(exp));
+        }
     }
-    ostr << val;
-    return String(ostr.str().c_str());
-}
+    
+    /* Formats val like an ostream with this precision would, without allocating */
+    void format(double val, char* buffer, std::size_t size) const
+    {
+        // + 0.0 turns a rounded -0 into 0
+        if (_norm > 0)
+            val = std::round(val * _norm) / _norm + 0.0;
+        
+        std::snprintf(buffer, size, "%.*g", _precision, val);
+        usePoint(buffer);
+    }
+    
+private:
+    /* snprintf writes the decimal separator of LC_NUMERIC, labels always show a point */
+    static void usePoint(char* buffer)
+    {
+        auto separator = std::localeconv()->decimal_point;
+        auto length = std::strlen(separator);
+        
+        if (length == 0 || (length == 1 && *separator == '.'))
+            return;
+        
+        if (auto found = std::strstr(buffer, separator))
+        {
+            *found = '.';
+            std::memmove(found + 1, found + length, std::strlen(found + length) + 1);
+        }
+    }
+    
+    int _precision;
+    double _norm = 0;
+};
+
+/*
+    Tick labels shaped once and kept by text, the least recently used ones are
+    dropped. While panning the same labels come back frame after frame.
+*/
+class LabelCache
+{
+public:
+    void draw(Graphics& graphics, const char* text, float x, float y, Justification justification)
+    {
+        auto& font = graphics.getCurrentFont();
+        if (font != _font)
+        {
+            _entries.clear();
+            _font = font;
+        }
+        
+        auto& entry = find(text);
+        
+        if (justification.testFlags(Justification::horizontallyCentred))
+            x -= entry.width / 2;
+        else if (justification.testFlags(Justification::right))
+            x -= entry.width;
+        
+        entry.glyphs.draw(graphics, AffineTransform::translation(x, y));
+    }
+    
+private:
+    static const std::size_t CAPACITY = 64;
+    static const std::size_t MAX_LENGTH = 32;
+    
+    struct Entry
+    {
+        char text[MAX_LENGTH];
+        GlyphArrangement glyphs;
+        float width;
+        std::uint64_t lastUse;
+    };
+    
+    Entry& find(const char* text)
+    {
+        ++_clock;
+        
+        for (auto& entry : _entries)
+        {
+            if (std::strncmp(entry.text, text, MAX_LENGTH) == 0)
+            {
+                entry.lastUse = _clock;
+                return entry;
+            }
+        }
+        
+        if (_entries.size() < CAPACITY)
+        {
+            _entries.emplace_back();
+        }
+        else
+        {
+            auto oldest = std::min_element(_entries.begin(), _entries.end(),
+                [](const Entry& lhs, const Entry& rhs) { return lhs.lastUse < rhs.lastUse; });
+            std::swap(*oldest, _entries.back());
+        }
+        
+        auto& entry = _entries.back();
+        std::strncpy(entry.text, text, MAX_LENGTH - 1);
+        entry.text[MAX_LENGTH - 1] = 0;
+        entry.lastUse = _clock;
+        
+        String label(entry.text);
+        entry.glyphs.clear();
+        entry.glyphs.addLineOfText(_font, label, 0, 0);
+        entry.width = _font.getStringWidthFloat(label);
+        
+        return entry;
+    }
+    
+    std::vector<Entry> _entries;
+    std::uint64_t _clock = 0;
+    Font _font;
+};
 
 /************************* CLASS FUNCTIONS ***************************/
 
+/*
+    Where the curves go on screen and the buffers to draw them, reused from curve
+    to curve. Whoever draws curves owns one: the paint thread and each frame
+    rendered in the background.
+*/
+class CurveRenderer
+{
+public:
+    void setGeometry(PlotRange range, juce::Rectangle<int> area)
+    {
+        _range = range;
+        _area = area;
+        _xPlot2Screen = area.getWidth() / range.getXRange();
+        _yPlot2Screen = area.getHeight() / range.getYRange();
+    }
+    
+    float screenX(double x) const
+    {
+        return (x - _range.loX) * _xPlot2Screen + _area.getX();
+    }
+    
+    float screenY(double y) const
+    {
+        return _area.getBottom() - (y - _range.loY) * _yPlot2Screen;
+    }
+    
+    double plotX(float screenX) const
+    {
+        return (screenX - _area.getX()) / _xPlot2Screen + _range.loX;
+    }
+    
+    /*
+        Draws curve index of sampler into region of image, an image of the plot
+        area at scale pixels per point. BITMAP draws 1 pixel lines straight into
+        it, aliased unless antialiased is set.
+    */
+    void draw(Image& image, juce::Rectangle<int> region, float scale, const PlotData& data,
+              const PlotSampler& sampler, int index, Rendering rendering, bool antialiased)
+    {
+        collectPoints(data, sampler, index);
+        
+        if (rendering == BITMAP)
+        {
+            Image::BitmapData bitmap(image, region.getX(), region.getY(), region.getWidth(), region.getHeight(),
+                                     Image::BitmapData::readWrite);
+            LineRaster raster(bitmap);
+            raster.setAntialiased(antialiased);
+            
+            auto originX = _area.getX() + region.getX() / scale;
+            auto originY = _area.getY() + region.getY() / scale;
+            
+            for (auto& point : _points)
+                point = Point<float>((point.getX() - originX) * scale, (point.getY() - originY) * scale);
+            
+            raster.setColour(data.colour);
+            raster.drawPolyline(_points.data(), _points.size());
+            return;
+        }
+        
+        Graphics graphics(image);
+        graphics.reduceClipRegion(region);
+        graphics.addTransform(AffineTransform::translation(static_cast<float>(-_area.getX()), static_cast<float>(-_area.getY()))
+                                  .scaled(scale));
+        strokePath(graphics, data.colour);
+    }
+    
+    /* Draws curve index of sampler in screen coordinates */
+    void draw(Graphics& graphics, const PlotData& data, const PlotSampler& sampler, int index)
+    {
+        collectPoints(data, sampler, index);
+        strokePath(graphics, data.colour);
+    }
+    
+private:
+    
+    /* One path per curve, its storage reused from frame to frame */
+    void strokePath(Graphics& graphics, juce::Colour colour)
+    {
+        _path.clear();
+        _path.preallocateSpace(3 * static_cast<int>(_points.size()));
+        
+        auto newSubPath = true;
+        
+        for (auto& point : _points)
+        {
+            if (! std::isfinite(point.getX()) || ! std::isfinite(point.getY()))
+            {
+                newSubPath = true;
+                continue;
+            }
+            
+            if (newSubPath)
+                _path.startNewSubPath(point);
+            else
+                _path.lineTo(point);
+            
+            newSubPath = false;
+        }
+        
+        graphics.setColour(colour);
+        graphics.strokePath(_path, PathStrokeType(1.0f));
+    }
+    
+    /* Screen positions of a curve, NaN where it is interrupted */
+    void collectPoints(const PlotData& data, const PlotSampler& sampler, int index)
+    {
+        _points.clear();
+        
+        if (collectEnvelope(data))
+            return;
+        
+        auto& xs = sampler.getXs();
+        auto& ys = sampler.getYs(index);
+        
+        for (std::size_t i = 0; i < xs.size(); ++i)
+            _points.emplace_back(screenX(xs[i]), screenY(ys[i]));
+    }
+    
+    /*
+        Dense samples are drawn per pixel column: a vertical line over the column's
+        y range, joined to the next column from its last to the next first sample.
+        That is pixel for pixel the line through all samples, whatever their number.
+    */
+    bool collectEnvelope(const PlotData& data)
+    {
+        if (_area.getWidth() <= 0)
+            return false;
+        
+        auto numColumns = static_cast<std::size_t>(_area.getWidth());
+        _edges.resize(numColumns + 1);
+        _columns.resize(numColumns);
+        
+        for (std::size_t i = 0; i <= numColumns; ++i)
+            _edges[i] = plotX(static_cast<float>(_area.getX() + i));
+        
+        if (! data.expr.envelope(_edges.data(), numColumns, _columns.data()))
+            return false;
+        
+        for (std::size_t i = 0; i < numColumns; ++i)
+        {
+            auto& column = _columns[i];
+            if (std::isnan(column.min))
+                continue;
+            
+            auto centre = _area.getX() + i + 0.5f;
+            
+            _points.emplace_back(centre, screenY(column.first));
+            _points.emplace_back(centre, screenY(column.min));
+            _points.emplace_back(centre, screenY(column.max));
+            _points.emplace_back(centre, screenY(column.last));
+        }
+        
+        return true;
+    }
+    
+    PlotRange _range;
+    juce::Rectangle<int> _area;
+    double _xPlot2Screen = 0, _yPlot2Screen = 0;
+    
+    std::vector<Point<float>> _points;
+    Path _path;
+    
+    // Pixel column edges and summaries for dense samples
+    std::vector<double> _edges;
+    std::vector<ColumnEnvelope> _columns;
+};
+
+/* Adds the time until it goes out of scope to a stage of the frame being recorded, if there is one */
+class StageTimer
+{
+public:
+    StageTimer(FrameStats* stats, double FrameStats::* stage)
+        : _stage(stats != nullptr ? &(stats->*stage) : nullptr),
+          _start(_stage != nullptr ? Time::getHighResolutionTicks() : 0)
+    {
+    }
+    
+    ~StageTimer()
+    {
+        if (_stage != nullptr)
+            *_stage += 1000.0 * Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - _start);
+    }
+    
+private:
+    double* _stage;
+    int64 _start;
+};
+
 struct PlotStream::Impl
 {
+    ~Impl()
+    {
+        // Frame jobs work on this
+        cancelFrames(-1);
+    }
+    
     void plot(Graphics& graphics)
     {
-        drawAxes(graphics);
+        if (! _instrumented)
+        {
+            paint(graphics);
+            return;
+        }
         
-        /* Draw curve */
-        for (auto& data : _plotData)
+        _frameStats = FrameStats();
+        _frameStats.frame = _numFramesRecorded++;
+        _frameStats.startTime = Time::getMillisecondCounterHiRes();
+        _stats = &_frameStats;
+        
+        auto allocations = _countAllocations ? _countAllocations() : 0;
+        
+        {
+            StageTimer timer(_stats, &FrameStats::total);
+            paint(graphics);
+        }
+        
+        if (_countAllocations)
+            _frameStats.numAllocations = _countAllocations() - allocations;
+        
+        _stats = nullptr;
+        _statsRing.push(_frameStats);
+    }
+    
+    void setInstrumentation(bool enabled, std::function<std::size_t()> countAllocations)
+    {
+        _instrumented = enabled;
+        _countAllocations = std::move(countAllocations);
+    }
+    
+    const FrameStatsRing& getFrameStats() const
+    {
+        return _statsRing;
+    }
+    
+    void paint(Graphics& graphics)
+    {
+        {
+            StageTimer timer(_stats, &FrameStats::axes);
+            drawAxesLayer(graphics);
+        }
+        
+        if (_plotData.empty())
+            return;
+        
+        Graphics::ScopedSaveState state(graphics);
+        graphics.reduceClipRegion(getPlotArea());
+        
+        if (_background)
+        {
+            requestFrame(graphics.getInternalContext().getPhysicalPixelScaleFactor());
+            drawFrame(graphics);
+            return;
+        }
+        
+        if (_panning || _stripWidth > 0 || _rendering == BITMAP || _quality == DRAFT)
         {
-            drawFunc(graphics, data);
+            drawLayer(graphics);
+            return;
         }
+        
+        evaluateSeries();
+        
+        /* Draw curve */
+        StageTimer timer(_stats, &FrameStats::rasterization);
+        
+        for (std::size_t i = 0; i < _plotData.size(); ++i)
+            _curves.draw(graphics, _plotData[i], getSamples().sampler, static_cast<int>(i));
     }
 
     void setSize(int width, int height)
@@ -56,12 +424,14 @@ struct PlotStream::Impl
         _winHeight = height;
         
         updatePlotRange();
+        _axesOutdated = true;
     }
     
     void setPlotRange(PlotRange plotRange)
     {
         _plotRange = plotRange;
         updatePlotRange();
+        _axesOutdated = true;
     }
     
     PlotRange getPlotRange()
@@ -69,17 +439,146 @@ struct PlotStream::Impl
         return _plotRange;
     }
     
+    void setSampling(Sampling sampling)
+    {
+        _sampling = sampling;
+    }
+    
+    void setRendering(Rendering rendering)
+    {
+        _rendering = rendering;
+    }
+    
+    void setBackgroundRendering(bool enabled, std::function<void()> onFrameReady)
+    {
+        cancelFrames(-1);
+        
+        _background = enabled;
+        _onFrameReady = std::move(onFrameReady);
+        _frameRequested = false;
+        
+        const ScopedLock lock(_frameLock);
+        _frame = nullptr;
+    }
+    
+    void setPanning(bool panning)
+    {
+        _panning = panning;
+        _layerValid = false;
+    }
+    
+    void setQuality(Quality quality)
+    {
+        if (quality == _quality)
+            return;
+        
+        _quality = quality;
+        _axesOutdated = true;
+        _layerValid = false;
+    }
+    
+    juce::Rectangle<int> getPlotArea() const
+    {
+        return { LEFT_BORDER, _winHeight - BORDER_HEIGHT - _plotHeight, _plotWidth, _plotHeight };
+    }
+    
     void updatePlotRange()
     {
         _plotWidth = _winWidth - BORDER_WIDTH - LEFT_BORDER;
         _plotHeight = _winHeight - 2 * BORDER_WIDTH;
         _xPlot2Screen = _plotWidth / _plotRange.getXRange();
         _yPlot2Screen = _plotHeight / _plotRange.getYRange();
+        _curves.setGeometry(_plotRange, getPlotArea());
+    }
+    
+    void addPlotData(Expression expr, juce::Colour colour, juce::String name, Precision precision)
+    {
+        _plotData.emplace_back(expr, name, colour, precision);
+        _curvePrograms.emplace_back();
+        _programOutdated = true;
+        ++_dataVersion;
     }
     
-    void addPlotData(Expression expr, juce::Colour colour = juce::Colours::transparentBlack, juce::String name = juce::String::empty)
+    void setPlotData(int index, Expression expr)
     {
-        _plotData.emplace_back(expr, name, colour);
+        jassert(index >= 0 && index < static_cast<int>(_plotData.size()));
+        
+        _plotData[index].expr = std::move(expr);
+        _curvePrograms[index] = Program();
+        _programOutdated = true;
+        ++_dataVersion;
+    }
+    
+    void setPlotData(int index, const Program& program)
+    {
+        jassert(index >= 0 && index < static_cast<int>(_plotData.size()));
+        
+        // The curve is compiled as a placeholder once, linkProgram() puts program in its place
+        if (_curvePrograms[index].getNumOutputs() == 0)
+        {
+            _plotData[index].expr = std::numeric_limits<double>::quiet_NaN();
+            _programOutdated = true;
+        }
+        
+        _curvePrograms[index] = program;
+        _programLinked = false;
+        ++_dataVersion;
+    }
+    
+    void addPlotData(LiveSamples samples, juce::Colour colour, juce::String name)
+    {
+        _liveSamples.push_back(samples);
+        addPlotData(std::move(samples), colour, name, EXACT);
+    }
+    
+    bool update()
+    {
+        auto hasPending = [](const LiveSamples& samples) { return samples.hasPending(); };
+        if (std::none_of(_liveSamples.begin(), _liveSamples.end(), hasPending))
+            return false;
+        
+        auto newestX = -std::numeric_limits<double>::infinity();
+        auto numDrained = 0;
+        
+        for (auto& samples : _liveSamples)
+        {
+            // Only what lies right of the samples drawn so far changes
+            auto lastX = samples.getLastX();
+            auto drained = samples.drain();
+            
+            if (drained > 0)
+                _updatedFromX = std::min(_updatedFromX, lastX);
+            
+            numDrained += drained;
+            newestX = std::max(newestX, samples.getLastX());
+        }
+        
+        // A frame still reads the copies shown before, they are drained next time
+        if (numDrained == 0)
+            return false;
+        
+        // Frames of the old samples are dropped without waiting for them
+        ++_generation;
+        ++_dataVersion;
+        
+        if (_stripWidth > 0 && std::isfinite(newestX))
+            followNewest(newestX);
+        else
+            _layerValid = false;
+        
+        return true;
+    }
+    
+    void invalidate()
+    {
+        ++_dataVersion;
+        _layerValid = false;
+    }
+    
+    void setStripChart(double width)
+    {
+        _stripWidth = width;
+        _layerValid = false;
     }
     
     /* Convert graph x value to screen coordinate */
@@ -114,25 +613,525 @@ private:
                || std::abs(x-y) < std::numeric_limits<float>::min();
     }
     
-    void drawFunc(juce::Graphics& graphics, const PlotData& data)
+    void compileProgram()
+    {
+        if (_programOutdated)
+        {
+            _compiledProgram = Program::compile(_plotData);
+            _programOutdated = false;
+            _programLinked = false;
+        }
+        
+        if (! _programLinked)
+            linkProgram();
+    }
+    
+    /* Curves set as programs take the place of their placeholders, without compiling */
+    void linkProgram()
+    {
+        _program = _compiledProgram;
+        
+        for (std::size_t i = 0; i < _curvePrograms.size(); ++i)
+            if (_curvePrograms[i].getNumOutputs() > 0)
+                _program.setOutput(static_cast<int>(i), _curvePrograms[i], _plotData[i].precision);
+        
+        _programLinked = true;
+    }
+    
+    /* The view samples were taken for */
+    struct SampleKey
+    {
+        PlotRange range;
+        juce::Rectangle<int> area;
+        Sampling sampling;
+        Quality quality;
+        uint32 dataVersion;
+        
+        bool operator== (const SampleKey& other) const
+        {
+            return range == other.range && area == other.area && sampling == other.sampling
+                && quality == other.quality && dataVersion == other.dataVersion;
+        }
+    };
+    
+    /* Curves sampled for a view, with the scales they were last sampled anew at */
+    struct SampleCache
+    {
+        PlotSampler sampler;
+        SampleKey key;
+        bool valid = false;
+        double xScale = 0, yScale = 0;
+    };
+    
+    /* Draft frames have samples of their own, so that they leave the FULL ones to refine */
+    SampleCache& getSamples()
+    {
+        return _quality == DRAFT ? _draftSamples : _fullSamples;
+    }
+    
+    /*
+        Samples are kept for the view they were taken for: repainting the same
+        view, e.g. for a focus change or an overlay, evaluates nothing. Zooming
+        into it refines them, see canRefine(), even after the draft frames drawn
+        while zooming. New data changes _dataVersion, which drops them.
+    */
+    void evaluateSeries()
+    {
+        StageTimer timer(_stats, &FrameStats::evaluation);
+        
+        compileProgram();
+        
+        auto area = getPlotArea();
+        auto& samples = getSamples();
+        SampleKey key { _plotRange, area, _sampling, _quality, _dataVersion };
+        
+        if (samples.valid && key == samples.key)
+            return;
+        
+        auto xScale = area.getWidth() / _plotRange.getXRange();
+        auto yScale = area.getHeight() / _plotRange.getYRange();
+        
+        if (canRefine(samples, key, xScale, yScale))
+        {
+            ignoreEnvelopeCurves(samples.sampler, _plotData, _plotRange.loX, _plotRange.hiX, xScale);
+            samples.sampler.refineAdaptive(_program, _plotRange.loX, _plotRange.hiX, xScale, yScale, FAST);
+        }
+        else
+        {
+            sampleCurves(samples.sampler, _program, _plotData, _plotRange, area, _sampling, _quality);
+            samples.xScale = xScale;
+            samples.yScale = yScale;
+        }
+        
+        samples.key = key;
+        samples.valid = true;
+        countSamples(samples.sampler);
+    }
+    
+    /*
+        A view inside the sampled one, zoomed in by at most MAX_REFINE_ZOOM since
+        the curves were last sampled anew: a bend the samples missed back then is
+        at most that many times the tolerance off now, and refineAdaptive() looks
+        for all it can see.
+    */
+    static bool canRefine(const SampleCache& samples, const SampleKey& key, double xScale, double yScale)
+    {
+        return samples.valid && key.sampling == ADAPTIVE && key.quality == FULL
+            && samples.key.sampling == ADAPTIVE && samples.key.quality == FULL
+            && key.dataVersion == samples.key.dataVersion
+            && key.range.loX >= samples.key.range.loX && key.range.hiX <= samples.key.range.hiX
+            && xScale <= MAX_REFINE_ZOOM * samples.xScale && yScale <= MAX_REFINE_ZOOM * samples.yScale;
+    }
+    
+    void countSamples(const PlotSampler& sampler)
+    {
+        if (_stats != nullptr)
+            _stats->numSamples += sampler.getNumEvaluated() * _plotData.size();
+    }
+    
+    /* Evaluates all curves together, subexpressions they share are computed once */
+    static void sampleCurves(PlotSampler& sampler, const Program& program, const std::vector<PlotData>& plotData,
+                             PlotRange range, juce::Rectangle<int> area, Sampling sampling, Quality quality)
+    {
+        auto xPlot2Screen = area.getWidth() / range.getXRange();
+        auto yPlot2Screen = area.getHeight() / range.getYRange();
+        
+        // Each curve's precision is part of the program
+        if (quality == DRAFT)
+        {
+            sampler.sampleUniform(program, range.loX, range.hiX, getNumDraftSamples(area.getWidth()), FAST);
+        }
+        else if (sampling == ADAPTIVE)
+        {
+            ignoreEnvelopeCurves(sampler, plotData, range.loX, range.hiX, xPlot2Screen);
+            sampler.sampleAdaptive(program, range.loX, range.hiX, xPlot2Screen, yPlot2Screen, FAST);
+        }
+        else
+        {
+            sampler.sampleUniform(program, range.loX, range.hiX, Grain::MEDIUM + 1, FAST);
+        }
+    }
+    
+    /*
+        Curves drawn from their envelope at this scale, see CurveRenderer::collectEnvelope(),
+        are left out of adaptive sampling: the bends of dense samples would
+        split every interval down to the minimum spacing, for samples that are not drawn.
+    */
+    static void ignoreEnvelopeCurves(PlotSampler& sampler, const std::vector<PlotData>& plotData,
+                                     double loX, double hiX, double xScale)
+    {
+        // Kept per thread, frame jobs sample too
+        static thread_local std::vector<double> edges;
+        static thread_local std::vector<ColumnEnvelope> columns;
+        static thread_local std::vector<bool> ignored;
+        
+        auto numColumns = static_cast<std::size_t>(std::max(1.0, std::ceil((hiX - loX) * xScale)));
+        edges.resize(numColumns + 1);
+        columns.resize(numColumns);
+        
+        for (std::size_t i = 0; i <= numColumns; ++i)
+            edges[i] = loX + i / xScale;
+        
+        ignored.resize(plotData.size());
+        for (std::size_t i = 0; i < plotData.size(); ++i)
+            ignored[i] = plotData[i].expr.envelope(edges.data(), numColumns, columns.data());
+        
+        sampler.setIgnoredOutputs(ignored);
+    }
+    
+    /*
+        Curves drawn into an image at the display's pixel density, which is kept.
+        While panning, a range moved by whole pixels shifts the image instead:
+        only the strip of newly exposed columns is evaluated, and only the
+        exposed strips are drawn, so a frame costs what the drag uncovered.
+    */
+    void drawLayer(juce::Graphics& graphics)
+    {
+        auto area = getPlotArea();
+        if (area.isEmpty())
+            return;
+        
+        auto scale = graphics.getInternalContext().getPhysicalPixelScaleFactor();
+        auto width = roundToInt(area.getWidth() * scale);
+        auto height = roundToInt(area.getHeight() * scale);
+        
+        if (_layer.getWidth() != width || _layer.getHeight() != height || scale != _layerScale)
+        {
+            _layer = Image(Image::ARGB, width, height, true);
+            _layerScale = scale;
+            _layerValid = false;
+        }
+        
+        // Offset of the new range from the drawn one, in layer pixels
+        auto shiftX = (_layerRange.loX - _plotRange.loX) * _xPlot2Screen * scale;
+        auto shiftY = (_plotRange.loY - _layerRange.loY) * _yPlot2Screen * scale;
+        auto pixelsX = roundToInt(shiftX);
+        auto pixelsY = roundToInt(shiftY);
+        
+        auto canShift = (_panning || _stripWidth > 0) && _layerValid && ! _programOutdated && _programLinked
+            && almostEqual(_layerRange.getXRange(), _plotRange.getXRange())
+            && almostEqual(_layerRange.getYRange(), _plotRange.getYRange())
+            && std::abs(shiftX - pixelsX) < 0.01 && std::abs(shiftY - pixelsY) < 0.01
+            && std::abs(pixelsX) < width && std::abs(pixelsY) < height
+            && (pixelsY == 0 || _stripWidth == 0); // strip charts sample the newest columns only
+        
+        if (canShift)
+        {
+            shiftLayer(pixelsX, pixelsY);
+            
+            if (_updatedFromX < _plotRange.hiX)
+                renderFrom(_updatedFromX);
+        }
+        else
+        {
+            evaluateSeries();
+            renderLayer(_layer.getBounds());
+        }
+        
+        _layerRange = _plotRange;
+        _layerValid = true;
+        _updatedFromX = std::numeric_limits<double>::infinity();
+        
+        StageTimer timer(_stats, &FrameStats::compositing);
+        graphics.drawImageTransformed(_layer, AffineTransform::scale(1.0f / scale)
+                                                  .translated(static_cast<float>(area.getX()), static_cast<float>(area.getY())));
+    }
+    
+    void shiftLayer(int pixelsX, int pixelsY)
+    {
+        if (pixelsX == 0 && pixelsY == 0)
+            return;
+        
+        auto width = _layer.getWidth();
+        auto height = _layer.getHeight();
+        
+        _layer.moveImageSection(std::max(0, pixelsX), std::max(0, pixelsY),
+                                std::max(0, -pixelsX), std::max(0, -pixelsY),
+                                width - std::abs(pixelsX), height - std::abs(pixelsY));
+        
+        if (pixelsX != 0)
+        {
+            auto columns = pixelsX < 0 ? juce::Rectangle<int>(width + pixelsX, 0, -pixelsX, height)
+                                       : juce::Rectangle<int>(0, 0, pixelsX, height);
+            
+            // Sample the uncovered x range only, next to what was sampled before
+            auto area = getPlotArea();
+            auto loX = plotX(area.getX() + columns.getX() / _layerScale);
+            auto hiX = plotX(area.getX() + columns.getRight() / _layerScale);
+            
+            if (pixelsX < 0)
+                loX = _layerRange.hiX;
+            else
+                hiX = _layerRange.loX;
+            
+            sampleStrip(loX, hiX);
+            renderLayer(columns);
+        }
+        
+        if (pixelsY != 0)
+        {
+            auto rows = pixelsY > 0 ? juce::Rectangle<int>(0, 0, width, pixelsY)
+                                    : juce::Rectangle<int>(0, height + pixelsY, width, -pixelsY);
+            renderLayer(rows);
+        }
+    }
+    
+    /* Redraws the columns of the layer right of x */
+    void renderFrom(double x)
+    {
+        auto area = getPlotArea();
+        auto width = _layer.getWidth();
+        
+        // One column more for the line into the first new sample
+        auto left = jlimit(0, width, static_cast<int>(std::floor((screenX(x) - area.getX()) * _layerScale)) - 1);
+        if (left == width)
+            return;
+        
+        sampleStrip(plotX(area.getX() + left / _layerScale), _plotRange.hiX);
+        renderLayer({ left, 0, width - left, _layer.getHeight() });
+    }
+    
+    /*
+        Moves the x range so it ends at the newest sample. It moves in whole pixels
+        of the layer, which then scrolls and only has its newest columns redrawn.
+    */
+    void followNewest(double newestX)
+    {
+        auto pixel = _stripWidth / (std::max(1, _plotWidth) * std::max(1.0f, _layerScale));
+        auto hiX = std::ceil(newestX / pixel) * pixel;
+        
+        if (hiX != _plotRange.hiX || _plotRange.getXRange() != _stripWidth)
+            setPlotRange({ hiX - _stripWidth, hiX, _plotRange.loY, _plotRange.hiY });
+    }
+    
+    static std::size_t getNumDraftSamples(double pixels)
+    {
+        return 2 + static_cast<std::size_t>(std::max(0.0, pixels) / DRAFT_SPACING);
+    }
+    
+    void sampleStrip(double loX, double hiX)
+    {
+        StageTimer timer(_stats, &FrameStats::evaluation);
+        
+        if (_quality == DRAFT)
+        {
+            _stripSampler.sampleUniform(_program, loX, hiX, getNumDraftSamples((hiX - loX) * _xPlot2Screen), FAST);
+        }
+        else if (_sampling == ADAPTIVE)
+        {
+            ignoreEnvelopeCurves(_stripSampler, _plotData, loX, hiX, _xPlot2Screen);
+            _stripSampler.sampleAdaptive(_program, loX, hiX, _xPlot2Screen, _yPlot2Screen, FAST);
+        }
+        else
+        {
+            _stripSampler.sampleUniform(_program, loX, hiX, 2 + static_cast<std::size_t>((hiX - loX) / _plotRange.getIncrStep()), FAST);
+        }
+        
+        countSamples(_stripSampler);
+        
+        auto& samples = getSamples();
+        samples.sampler.merge(_stripSampler);
+        samples.sampler.trim(_plotRange.loX, _plotRange.hiX);
+        samples.valid = false;
+    }
+    
+    /* Redraws the curves inside region of the layer */
+    void renderLayer(juce::Rectangle<int> region)
+    {
+        StageTimer timer(_stats, &FrameStats::rasterization);
+        
+        _layer.clear(region);
+        
+        auto rendering = _quality == DRAFT ? BITMAP : _rendering;
+        auto& sampler = getSamples().sampler;
+        
+        for (std::size_t i = 0; i < _plotData.size(); ++i)
+            _curves.draw(_layer, region, _layerScale, _plotData[i], sampler, static_cast<int>(i), rendering, _quality == FULL);
+    }
+    
+    /* What a background frame is drawn for */
+    struct FrameRequest
+    {
+        PlotRange range;
+        juce::Rectangle<int> area;
+        float scale;
+        Sampling sampling;
+        Rendering rendering;
+        Quality quality;
+        uint32 dataVersion;
+        
+        bool operator== (const FrameRequest& other) const
+        {
+            return range == other.range && area == other.area && scale == other.scale && sampling == other.sampling
+                && rendering == other.rendering && quality == other.quality && dataVersion == other.dataVersion;
+        }
+    };
+    
+    /* Curves drawn in the background, an image of the plot area each */
+    struct Frame
+    {
+        FrameRequest request;
+        std::vector<Image> images;
+    };
+    
+    /*
+        Samples and draws a frame on the shared pool, from copies of the curves
+        made when it was requested. It is dropped as soon as a newer frame is
+        requested, checked before each curve.
+    */
+    class FrameJob : public ThreadPoolJob
+    {
+    public:
+        FrameJob(Impl& owner, const FrameRequest& request, uint32 generation)
+            : ThreadPoolJob("PlotStream frame"), _owner(owner), _request(request), _generation(generation),
+              _plotData(owner._plotData), _program(owner._program)
+        {
+        }
+        
+        JobStatus runJob() override
+        {
+            auto& request = _request;
+            
+            PlotSampler sampler;
+            sampleCurves(sampler, _program, _plotData, request.range, request.area, request.sampling, request.quality);
+            
+            auto frame = std::make_shared<Frame>();
+            frame->request = request;
+            frame->images.resize(_plotData.size());
+            
+            auto width = roundToInt(request.area.getWidth() * request.scale);
+            auto height = roundToInt(request.area.getHeight() * request.scale);
+            auto rendering = request.quality == DRAFT ? BITMAP : request.rendering;
+            
+            // Each curve into its image on its own thread, composited in order by drawFrame()
+            parallel::forEach(_plotData.size(), [&](std::size_t i)
+            {
+                if (isStale())
+                    return;
+                
+                CurveRenderer curves;
+                curves.setGeometry(request.range, request.area);
+                
+                // Software images, native ones may not be drawn on other threads
+                Image image(Image::ARGB, width, height, true, SoftwareImageType());
+                curves.draw(image, image.getBounds(), request.scale, _plotData[i], sampler, static_cast<int>(i),
+                            rendering, request.quality == FULL);
+                frame->images[i] = image;
+            });
+            
+            if (! isStale())
+                _owner.finishFrame(std::move(frame), _generation);
+            
+            return jobHasFinished;
+        }
+        
+        bool isFor(const Impl& owner) const
+        {
+            return &owner == &_owner;
+        }
+        
+    private:
+        bool isStale() const
+        {
+            return shouldExit() || _owner._generation.load() != _generation;
+        }
+        
+        Impl& _owner;
+        FrameRequest _request;
+        uint32 _generation;
+        std::vector<PlotData> _plotData;
+        Program _program;
+    };
+    
+    /* Queues a frame for the current state unless that one is already on its way */
+    void requestFrame(float scale)
     {
-        graphics.setColour(data.colour);
+        auto area = getPlotArea();
+        if (area.isEmpty())
+            return;
+        
+        FrameRequest request { _plotRange, area, scale, _sampling, _rendering, _quality, _dataVersion };
+        
+        if (_frameRequested && request == _request)
+            return;
         
-        auto incr = _plotRange.getIncrStep();
-        auto& expr = data.expr;
+        compileProgram();
+        _request = request;
+        _frameRequested = true;
         
-        auto loX = _plotRange.loX;
-        Point<float> start(screenX(loX), screenY(expr[loX]));
+        auto generation = ++_generation;
+        cancelFrames(0);
+        parallel::getSharedPool().addJob(new FrameJob(*this, request, generation), true);
+    }
+    
+    /* Picks the frame jobs of one plot out of the shared pool */
+    struct FrameJobSelector : ThreadPool::JobSelector
+    {
+        FrameJobSelector(const Impl& owner) : _owner(owner)
+        {
+        }
         
-        for (auto x = loX + incr; x <= _plotRange.hiX; x += incr)
+        bool isJobSuitable(ThreadPoolJob* job) override
         {
-            auto y = expr[x];
-            auto nextPoint = Point<float>(screenX(x), screenY(y));
-            graphics.drawLine(start.getX(), start.getY(), nextPoint.getX(), nextPoint.getY());
-            start = nextPoint;
+            auto frameJob = dynamic_cast<FrameJob*>(job);
+            return frameJob != nullptr && frameJob->isFor(_owner);
+        }
+        
+        const Impl& _owner;
+    };
+    
+    /* Removes queued frames and tells running ones to stop, waiting up to timeout ms for them */
+    void cancelFrames(int timeout)
+    {
+        FrameJobSelector selector(*this);
+        parallel::getSharedPool().removeAllJobs(true, timeout, &selector);
+    }
+    
+    /* Called on the worker thread */
+    void finishFrame(std::shared_ptr<const Frame> frame, uint32 generation)
+    {
+        {
+            const ScopedLock lock(_frameLock);
+            
+            if (generation != _generation.load())
+                return;
+            
+            _frame = std::move(frame);
         }
+        
+        if (_onFrameReady)
+            _onFrameReady();
     }
     
+    /*
+        The last finished frame, mapped from the range it was drawn for onto the
+        current one: until the next frame is ready it follows zooms and drags.
+    */
+    void drawFrame(juce::Graphics& graphics)
+    {
+        std::shared_ptr<const Frame> frame;
+        
+        {
+            const ScopedLock lock(_frameLock);
+            frame = _frame;
+        }
+        
+        if (frame == nullptr)
+            return;
+        
+        StageTimer timer(_stats, &FrameStats::compositing);
+        auto& request = frame->request;
+        auto scaleX = static_cast<float>(_xPlot2Screen * request.range.getXRange() / request.area.getWidth());
+        auto scaleY = static_cast<float>(_yPlot2Screen * request.range.getYRange() / request.area.getHeight());
+        
+        auto transform = AffineTransform::scale(1.0f / request.scale)
+                             .translated(0.0f, static_cast<float>(-request.area.getHeight()))
+                             .scaled(scaleX, scaleY)
+                             .translated(screenX(request.range.loX), screenY(request.range.loY));
+        
+        for (auto& image : frame->images)
+            graphics.drawImageTransformed(image, transform);
+    }
     
     // Ancillary function used locally by drawSinglePoint()
     // draws the point shape in X and Y.
@@ -154,7 +1153,43 @@ private:
         start = min - remainder;
     }
     
-    /* Draws the axes */
+    /*
+        Axes, grid and labels only change with the plot range or the window size,
+        they are drawn into an image then and blitted on every other frame.
+        The image is only allocated anew when its size changes.
+    */
+    void drawAxesLayer(juce::Graphics& graphics)
+    {
+        if (_winWidth <= 0 || _winHeight <= 0)
+            return;
+        
+        auto scale = graphics.getInternalContext().getPhysicalPixelScaleFactor();
+        auto width = roundToInt(_winWidth * scale);
+        auto height = roundToInt(_winHeight * scale);
+        
+        if (_axesLayer.getWidth() != width || _axesLayer.getHeight() != height || scale != _axesScale)
+        {
+            _axesLayer = Image(Image::ARGB, width, height, true);
+            _axesScale = scale;
+            _axesOutdated = true;
+        }
+        else if (_axesOutdated)
+        {
+            _axesLayer.clear(_axesLayer.getBounds());
+        }
+        
+        if (_axesOutdated)
+        {
+            _axesOutdated = false;
+            
+            Graphics layerGraphics(_axesLayer);
+            layerGraphics.addTransform(AffineTransform::scale(scale));
+            drawAxes(layerGraphics);
+        }
+        
+        graphics.drawImageTransformed(_axesLayer, AffineTransform::scale(1.0f / scale));
+    }
+    
     void drawAxes(juce::Graphics& graphics)
     {
         // draw the rectangle
@@ -177,15 +1212,21 @@ private:
         double xStart, xStep;
         getAxisSteps(_plotRange.loX, _plotRange.hiX, maxXDivs, xStart, xStep);
 
+        char label[32];
+        LabelFormat xFormat(2, xStep);
+        
         for (auto x = xStart; x <= _plotRange.hiX; x += xStep)
         {
             auto xOffset = screenX(x);
             if (! (almostEqual(x, _plotRange.loX) || almostEqual(x, _plotRange.hiX)))
             {
-                graphics.setColour(Colours::lightgrey);
-                graphics.drawDashedLine(Line<float>(xOffset, BORDER_HEIGHT,
-                                                    xOffset, _winHeight - BORDER_HEIGHT),
-                                        dashPattern, 2);
+                if (_quality == FULL)
+                {
+                    graphics.setColour(Colours::lightgrey);
+                    graphics.drawDashedLine(Line<float>(xOffset, BORDER_HEIGHT,
+                                                        xOffset, _winHeight - BORDER_HEIGHT),
+                                            dashPattern, 2);
+                }
                 
                 graphics.setColour(Colours::darkgrey);
                 graphics.drawLine(xOffset, _winHeight - BORDER_HEIGHT,
@@ -193,23 +1234,28 @@ private:
                 graphics.drawLine(xOffset, BORDER_HEIGHT,
                                   xOffset, BORDER_HEIGHT + MARK_LENGTH);
             }
-            auto asciival = dtoa(x, 2, xStep);
+            xFormat.format(x, label, sizeof(label));
             int ypos = _winHeight - BORDER_HEIGHT / 2 + 5;
-            graphics.drawSingleLineText(asciival, xOffset, ypos, Justification::horizontallyCentred);
+            _labels.draw(graphics, label, xOffset, ypos, Justification::horizontallyCentred);
         }
 
         double yStart, yStep;
         auto maxYDivs = _plotHeight / minDivWidth;
         getAxisSteps(_plotRange.loY, _plotRange.hiY, maxYDivs, yStart, yStep);
+        LabelFormat yFormat(2, yStep);
+        
         for (auto y = yStart; y <= _plotRange.hiY; y += yStep)
         {
             auto yOffset = screenY(y);
             if (! (almostEqual(y, _plotRange.loY) || almostEqual(y, _plotRange.hiY)))
             {
-                graphics.setColour(Colours::lightgrey);
-                graphics.drawDashedLine(Line<float>(LEFT_BORDER, yOffset,
-                                                    _winWidth - BORDER_WIDTH, yOffset),
-                                        dashPattern, 2);
+                if (_quality == FULL)
+                {
+                    graphics.setColour(Colours::lightgrey);
+                    graphics.drawDashedLine(Line<float>(LEFT_BORDER, yOffset,
+                                                        _winWidth - BORDER_WIDTH, yOffset),
+                                            dashPattern, 2);
+                }
                 
                 graphics.setColour(Colours::darkgrey);
                 graphics.drawLine(LEFT_BORDER, yOffset,
@@ -219,8 +1265,8 @@ private:
             }
             
             int xpos = LEFT_BORDER - 3;
-            auto asciival = dtoa(y, 2, yStep);
-            graphics.drawSingleLineText(asciival, xpos, yOffset + fontHeight / 2 - 1, Justification::right);
+            yFormat.format(y, label, sizeof(label));
+            _labels.draw(graphics, label, xpos, yOffset + fontHeight / 2 - 1, Justification::right);
         }
     }
 
@@ -231,8 +1277,66 @@ private:
     double _xPlot2Screen, _yPlot2Screen;
     
     std::vector<PlotData> _plotData;
+    std::vector<LiveSamples> _liveSamples;
     PlotRange _plotRange;
     
+    // All curves compiled together, rebuilt when a curve is added
+    Program _compiledProgram;
+    bool _programOutdated = false;
+    
+    // Curves set as programs, empty for the others
+    std::vector<Program> _curvePrograms;
+    
+    // _compiledProgram with the curve programs linked in, what is evaluated
+    Program _program;
+    bool _programLinked = false;
+    
+    SampleCache _fullSamples;
+    SampleCache _draftSamples;
+    Sampling _sampling = ADAPTIVE;
+    
+    // Axes are redrawn only when outdated
+    Image _axesLayer;
+    float _axesScale = 0;
+    bool _axesOutdated = true;
+    LabelCache _labels;
+    
+    // Curve drawing, reused across frames
+    Rendering _rendering = PATH;
+    CurveRenderer _curves;
+    
+    // Curves drawn for _layerRange, shifted while panning
+    Image _layer;
+    PlotRange _layerRange;
+    float _layerScale = 0;
+    bool _layerValid = false;
+    bool _panning = false;
+    PlotSampler _stripSampler;
+    
+    // Strip chart: x range following the newest live sample, 0 when off
+    double _stripWidth = 0;
+    double _updatedFromX = std::numeric_limits<double>::infinity();
+    
+    Quality _quality = FULL;
+    
+    // Timings of the last frames, _stats is the frame being recorded, if any
+    bool _instrumented = false;
+    std::function<std::size_t()> _countAllocations;
+    FrameStats _frameStats;
+    FrameStats* _stats = nullptr;
+    uint64 _numFramesRecorded = 0;
+    FrameStatsRing _statsRing;
+    
+    // Curves drawn in the background, _frame is the last finished frame
+    bool _background = false;
+    std::function<void()> _onFrameReady;
+    FrameRequest _request;
+    bool _frameRequested = false;
+    std::atomic<uint32> _generation { 0 };
+    uint32 _dataVersion = 0;
+    CriticalSection _frameLock;
+    std::shared_ptr<const Frame> _frame;
+    
     juce::Colour _colour;
 };
 
@@ -246,6 +1350,31 @@ void PlotStream::setWindow(int width, int height)
     _impl->setSize(width, height);
 }
 
+void PlotStream::setSampling(Sampling sampling)
+{
+    _impl->setSampling(sampling);
+}
+
+void PlotStream::setRendering(Rendering rendering)
+{
+    _impl->setRendering(rendering);
+}
+
+void PlotStream::setBackgroundRendering(bool enabled, std::function<void()> onFrameReady)
+{
+    _impl->setBackgroundRendering(enabled, std::move(onFrameReady));
+}
+
+void PlotStream::setPanning(bool panning)
+{
+    _impl->setPanning(panning);
+}
+
+void PlotStream::setQuality(Quality quality)
+{
+    _impl->setQuality(quality);
+}
+
 void PlotStream::setPlotRange(PlotRange plotRange)
 {
     _impl->setPlotRange(plotRange);
@@ -256,9 +1385,49 @@ PlotRange PlotStream::getPlotRange()
     return _impl->getPlotRange();
 }
 
-void PlotStream::addPlotData(Expression expr, juce::Colour colour, juce::String name)
+void PlotStream::addPlotData(Expression expr, juce::Colour colour, juce::String name, Precision precision)
+{
+    _impl->addPlotData(expr, colour, name, precision);
+}
+
+void PlotStream::addPlotData(LiveSamples samples, juce::Colour colour, juce::String name)
+{
+    _impl->addPlotData(std::move(samples), colour, name);
+}
+
+void PlotStream::setPlotData(int index, Expression expr)
+{
+    _impl->setPlotData(index, std::move(expr));
+}
+
+void PlotStream::setPlotData(int index, const Program& program)
+{
+    _impl->setPlotData(index, program);
+}
+
+void PlotStream::setStripChart(double width)
+{
+    _impl->setStripChart(width);
+}
+
+bool PlotStream::update()
+{
+    return _impl->update();
+}
+
+void PlotStream::invalidate()
+{
+    _impl->invalidate();
+}
+
+void PlotStream::setInstrumentation(bool enabled, std::function<std::size_t()> countAllocations)
+{
+    _impl->setInstrumentation(enabled, std::move(countAllocations));
+}
+
+const FrameStatsRing& PlotStream::getFrameStats() const
 {
-    _impl->addPlotData(expr, colour, name);
+    return _impl->getFrameStats();
 }
 
 void PlotStream::plot(juce::Graphics& graphics)
@@ -290,5 +1459,77 @@ double PlotStream::plotY(float screenY) const
     return _impl->plotY(screenY);
 }
 
+/************************* TESTS ***************************/
+
+#if JUCE_UNIT_TESTS
+
+class PlotStreamTests : public juce::UnitTest
+{
+public:
+    PlotStreamTests() : juce::UnitTest("aot_juceplot PlotStream")
+    {
+    }
+
+    void runTest() override
+    {
+        beginTest("Tick labels show a point whatever the locale");
+
+        std::string locale = std::setlocale(LC_NUMERIC, nullptr);
+        char label[32];
+
+        for (auto name : { "C", "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8" })
+        {
+            // Only the locales the system has
+            if (std::setlocale(LC_NUMERIC, name) == nullptr)
+                continue;
+
+            LabelFormat(3, 0.01).format(-0.5, label, sizeof(label));
+            expectEquals(String(label), String("-0.5"), name);
+
+            LabelFormat(6).format(1234.5, label, sizeof(label));
+            expectEquals(String(label), String("1234.5"), name);
+        }
+
+        std::setlocale(LC_NUMERIC, locale.c_str());
+
+        beginTest("Zooming in refines the samples after draft frames");
+
+        Image image(Image::ARGB, 640, 480, true, SoftwareImageType());
+        PlotComponent component;
+        component.setSize(image.getWidth(), image.getHeight());
+        component.setPlotRange(-10, 10, -3, 3);
+        component.addPlotData(sin(x * x), Colours::blue, "sin(x^2)");
+        component.setInstrumentation(true);
+
+        auto sampled = paint(component, image);
+
+        // The draft frame drawn while zooming samples the curves on its own
+        component.beginInteraction();
+        component.zoom(0.5f, 0.5f, 0.8f, 0.8f);
+        paint(component, image);
+        component.endInteraction();
+
+        auto refined = paint(component, image);
+
+        expect(sampled > 0);
+        expect(refined < sampled / 2, "sampled " + String(sampled) + " and then " + String(refined));
+    }
+
+private:
+    /* Curve values computed for one frame */
+    static uint64 paint(PlotComponent& component, Image& image)
+    {
+        {
+            Graphics graphics(image);
+            component.paintEntireComponent(graphics, false);
+        }
+
+        FrameStats frame;
+        component.getFrameStats().getLatest(&frame, 1);
+        return frame.numSamples;
+    }
+};
 
+static PlotStreamTests plotStreamTests;
 
+#endif
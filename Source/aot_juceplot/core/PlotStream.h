@@ -7,6 +7,20 @@ enum Rounding
 	UP
 };
 
+/** How curves are drawn */
+enum Rendering
+{
+    PATH,       // one stroked juce::Path per curve
+    BITMAP      // 1 pixel antialiased lines drawn straight into an image
+};
+
+/** Trade-off between speed and looks */
+enum Quality
+{
+    DRAFT,      // few samples, aliased lines, no grid: for frames during interaction
+    FULL
+};
+
 class PlotStream
 {
 public:
@@ -15,6 +29,30 @@ public:
     void setWindow(int width, int height);
     
     void setPlotRange(PlotRange plotRange);
+    
+    /* ADAPTIVE by default */
+    void setSampling(Sampling sampling);
+    
+    /* PATH by default */
+    void setRendering(Rendering rendering);
+    
+    /*
+        Curves are sampled and drawn on the threads all plots share, plot() only
+        draws the last finished frame, stretched to the current range until a newer one is done.
+        A new range cancels frames still being drawn for an older one.
+        onFrameReady is called on the worker thread when a frame is ready to be
+        painted.
+    */
+    void setBackgroundRendering(bool enabled, std::function<void()> onFrameReady = nullptr);
+    
+    /*
+        While panning, frames reuse the previous one and only draw what the move
+        uncovered. Ending it makes the next frame a complete one.
+    */
+    void setPanning(bool panning);
+    
+    /* FULL by default */
+    void setQuality(Quality quality);
     PlotRange getPlotRange();
 	
     /* Convert graph x value to screen coordinate */
@@ -29,7 +67,53 @@ public:
     /* Convert screen coordinate to graph y value */
     double plotY(float screenY) const;
 
-    void addPlotData(Expression expr, juce::Colour colour = juce::Colours::transparentBlack, juce::String name = juce::String::empty);
+    void addPlotData(Expression expr, juce::Colour colour = juce::Colours::transparentBlack, juce::String name = juce::String::empty,
+                     Precision precision = EXACT);
+    
+    /* A curve fed from another thread, its new samples are shown after update() */
+    void addPlotData(LiveSamples samples, juce::Colour colour = juce::Colours::transparentBlack, juce::String name = juce::String::empty);
+    
+    /* Replaces the formula of curve index, all curves are compiled again */
+    void setPlotData(int index, Expression expr);
+    
+    /*
+        Replaces the formula of curve index with program as it is, e.g. on every
+        slider movement with a Program::TreeBuilder: program is copied next to
+        the other curves, nothing is compiled again.
+    */
+    void setPlotData(int index, const Program& program);
+    
+    /*
+        Drains the live curves, returns true if they changed and a repaint is due.
+        Call it on the thread that paints. Background frames still drawing the old
+        samples are dropped, it does not wait for them.
+    */
+    bool update();
+    
+    /*
+        Curves read data that grew or changed, e.g. a CsvLoader still loading:
+        drops the samples kept for the current view and draws them anew.
+    */
+    void invalidate();
+    
+    /*
+        Strip chart: update() moves the x range to end at the newest live sample,
+        width wide. Frames then scroll the curves drawn before and only draw
+        what arrived since. 0 turns it off.
+    */
+    void setStripChart(double width);
+    
+    /*
+        Records where the time of every plot() goes, per stage, into a ring of
+        the last frames that any thread can read. Off by default, which costs a
+        branch per stage. With background rendering, evaluation and rasterization
+        happen on the workers and are not part of the frames. countAllocations,
+        if given, returns the number of allocations the process made so far,
+        e.g. counted by a replaced operator new.
+    */
+    void setInstrumentation(bool enabled, std::function<std::size_t()> countAllocations = nullptr);
+    
+    const FrameStatsRing& getFrameStats() const;
     
     void plot(juce::Graphics& graphics);
 
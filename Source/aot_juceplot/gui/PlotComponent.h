@@ -1,6 +1,10 @@
 #pragma once
 
-class PlotComponent : public juce::Component
+/*
+    While the plot is zoomed or dragged it is drawn in DRAFT quality, FULL
+    quality follows once the user has been idle for getIdleTimeout() ms.
+*/
+class PlotComponent : public juce::Component, private juce::Timer, private juce::AsyncUpdater
 {
 public:
     PlotComponent()
@@ -17,14 +21,100 @@ public:
         _plotstream.setPlotRange({ loX, hiX, loY, hiY });
     }
 
-    void addPlotData(Expression expr, juce::Colour colour, juce::String name)
+    void setIdleTimeout(int milliseconds)
     {
-        _plotstream.addPlotData(std::move(expr), colour, name);
+        _idleTimeout = milliseconds;
+    }
+    
+    int getIdleTimeout() const
+    {
+        return _idleTimeout;
+    }
+    
+    void setSampling(Sampling sampling)
+    {
+        _plotstream.setSampling(sampling);
+    }
+    
+    void setRendering(Rendering rendering)
+    {
+        _plotstream.setRendering(rendering);
+    }
+    
+    /* Draws the curves on a worker thread, repainting when a frame is ready */
+    void setBackgroundRendering(bool enabled)
+    {
+        _plotstream.setBackgroundRendering(enabled, [this] { triggerAsyncUpdate(); });
+        repaint();
+    }
+    
+    void addPlotData(Expression expr, juce::Colour colour, juce::String name, Precision precision = EXACT)
+    {
+        _plotstream.addPlotData(std::move(expr), colour, name, precision);
+    }
+    
+    /* Live curves are drained and repainted getRefreshRate() times a second */
+    void addPlotData(LiveSamples samples, juce::Colour colour, juce::String name)
+    {
+        _plotstream.addPlotData(std::move(samples), colour, name);
+        _refreshTimer.startTimerHz(_refreshRate);
+    }
+    
+    /* Repaints curves whose data changed, call it on the message thread */
+    void dataChanged()
+    {
+        _plotstream.invalidate();
+        repaint();
+    }
+    
+    /* x range following the newest live sample, width wide, see PlotStream::setStripChart() */
+    void setStripChart(double width)
+    {
+        _plotstream.setStripChart(width);
+        repaint();
+    }
+    
+    /* Records frame timings, see PlotStream::setInstrumentation() */
+    void setInstrumentation(bool enabled, std::function<std::size_t()> countAllocations = nullptr)
+    {
+        _instrumented = enabled;
+        _countAllocations = std::move(countAllocations);
+        _plotstream.setInstrumentation(_instrumented || _overlay, _countAllocations);
+    }
+    
+    /* Frames per second and the time per stage drawn over the plot, recorded while it is shown */
+    void setOverlay(bool visible)
+    {
+        _overlay = visible;
+        _plotstream.setInstrumentation(_instrumented || _overlay, _countAllocations);
+        repaint();
+    }
+    
+    /* The last frames' timings, for telemetry to read from any thread */
+    const FrameStatsRing& getFrameStats() const
+    {
+        return _plotstream.getFrameStats();
+    }
+    
+    void setRefreshRate(int hz)
+    {
+        _refreshRate = hz;
+        
+        if (_refreshTimer.isTimerRunning())
+            _refreshTimer.startTimerHz(hz);
+    }
+    
+    int getRefreshRate() const
+    {
+        return _refreshRate;
     }
     
     void paint(juce::Graphics& g) override
     {
         _plotstream.plot(g);
+        
+        if (_overlay)
+            drawOverlay(g);
     }
     
     void resized() override
@@ -32,6 +122,24 @@ public:
         _plotstream.setWindow(getWidth(), getHeight());
     }
 
+    /*
+        Draws in DRAFT quality until getIdleTimeout() ms after the last call,
+        as the mouse does, for zoom() and move() driven by something else.
+    */
+    void beginInteraction()
+    {
+        _plotstream.setQuality(DRAFT);
+        startTimer(_idleTimeout);
+    }
+    
+    /* Goes back to FULL quality without waiting for the idle timeout */
+    void endInteraction()
+    {
+        stopTimer();
+        _plotstream.setQuality(FULL);
+        repaint();
+    }
+    
     void zoom(float splitX, float splitY, float zoomX, float zoomY)
     {
         jassert(zoomX > 0);
@@ -66,6 +174,7 @@ public:
         
         auto x = static_cast<float>(event.x) / getWidth();
         auto y = static_cast<float>(event.y) / getHeight();
+        beginInteraction();
         zoom(x, y, 1 + wheel.deltaX, 1 + wheel.deltaY);
         repaint();
     }
@@ -76,6 +185,7 @@ public:
         auto deltaY = _plotstream.plotY(_lastDragPoint.y) - _plotstream.plotY(event.position.y);
         _lastDragPoint = event.position;
         
+        beginInteraction();
         move(deltaX, deltaY);
         repaint();
     }
@@ -83,11 +193,94 @@ public:
     void mouseDown(const juce::MouseEvent& event) override
     {
         _lastDragPoint = event.position;
+        _plotstream.setPanning(true);
+    }
+    
+    void mouseUp(const juce::MouseEvent&) override
+    {
+        _plotstream.setPanning(false);
+        repaint();
     }
     
 private:
+    /* Averages of the last frames in the top left corner */
+    void drawOverlay(juce::Graphics& g)
+    {
+        FrameStats frames[OVERLAY_FRAMES];
+        auto numFrames = _plotstream.getFrameStats().getLatest(frames, OVERLAY_FRAMES);
+        
+        if (numFrames == 0)
+            return;
+        
+        FrameStats mean = {};
+        
+        for (auto i = 0; i < numFrames; ++i)
+        {
+            mean.total += frames[i].total / numFrames;
+            mean.axes += frames[i].axes / numFrames;
+            mean.evaluation += frames[i].evaluation / numFrames;
+            mean.rasterization += frames[i].rasterization / numFrames;
+            mean.compositing += frames[i].compositing / numFrames;
+            mean.numSamples += frames[i].numSamples;
+            mean.numAllocations += frames[i].numAllocations;
+        }
+        
+        auto seconds = (frames[numFrames - 1].startTime - frames[0].startTime) / 1000.0;
+        auto fps = seconds > 0 ? (numFrames - 1) / seconds : 0.0;
+        
+        auto text = "fps " + juce::String(fps, 1) + "   frame " + juce::String(mean.total, 2) + " ms\n"
+            + "axes " + juce::String(mean.axes, 2) + "  eval " + juce::String(mean.evaluation, 2)
+            + "  raster " + juce::String(mean.rasterization, 2) + "  comp " + juce::String(mean.compositing, 2) + " ms\n"
+            + "samples " + juce::String(static_cast<juce::int64>(mean.numSamples / numFrames))
+            + "  allocations " + juce::String(static_cast<juce::int64>(mean.numAllocations / numFrames));
+        
+        juce::Rectangle<int> area(8, 8, 280, 50);
+        
+        g.setColour(juce::Colours::black.withAlpha(0.6f));
+        g.fillRect(area);
+        g.setColour(juce::Colours::white);
+        g.setFont(12.0f);
+        g.drawFittedText(text, area.reduced(6, 4), juce::Justification::topLeft, 3);
+    }
+    
+    void timerCallback() override
+    {
+        endInteraction();
+    }
+    
+    void handleAsyncUpdate() override
+    {
+        repaint();
+    }
+    
+    /* Moves live samples into the plot, a Timer of its own next to the idle timer */
+    class RefreshTimer : public juce::Timer
+    {
+    public:
+        RefreshTimer(PlotComponent& owner) : _owner(owner)
+        {
+        }
+        
+        void timerCallback() override
+        {
+            if (_owner._plotstream.update())
+                _owner.repaint();
+        }
+        
+    private:
+        PlotComponent& _owner;
+    };
+    
     PlotStream _plotstream;
     juce::Point<float> _lastDragPoint;
+    int _idleTimeout = 200;
+    RefreshTimer _refreshTimer { *this };
+    int _refreshRate = 30;
+    
+    static const int OVERLAY_FRAMES = 30;
+    bool _instrumented = false;
+    bool _overlay = false;
+    std::function<std::size_t()> _countAllocations;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PlotComponent)
 };